@@ -17,8 +17,11 @@ GNU General Public License for more details.
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <iostream>
+#include <streambuf>
 
 #include <openbabel/mol.h>
 #include <openbabel/plugin.h>
@@ -26,9 +29,40 @@ GNU General Public License for more details.
 #include <openbabel/obconversion.h>
 
 #include "wlnparser.h"
+#include "wlndfa.h"
+#include "wlnoutput.h"
 
 FILE *fp;
 const char *format; 
+bool opt_verbose; 
+bool opt_check; 
+bool opt_filter; 
+bool opt_line_flush; 
+
+struct wln_output out; 
+
+
+/* lets the toolkit format molecules straight into the output buffer */
+class wln_streambuf : public std::streambuf {
+  struct wln_output *out; 
+
+public:
+  wln_streambuf(struct wln_output *o) : out(o) {}
+
+protected:
+  int overflow(int ch) {
+    if (ch != EOF) {
+      char c = ch; 
+      wln_output_write(out, &c, 1); 
+    }
+    return std::char_traits<char>::not_eof(ch); 
+  }
+
+  std::streamsize xsputn(const char *str, std::streamsize n) {
+    wln_output_write(out, str, n); 
+    return n; 
+  }
+};
 
 
 static unsigned char 
@@ -82,18 +116,73 @@ process_file(FILE *fp)
 {
   OpenBabel::OBMol mol;
   OpenBabel::OBConversion conv;
+  wln_streambuf outbuf(&out); 
+  std::ostream os(&outbuf); 
   
-  conv.SetOutFormat(format);
+  if (format)
+    conv.SetOutFormat(format);
   conv.AddOption("h",OpenBabel::OBConversion::OUTOPTIONS);
   
+  unsigned int nread = 0; 
+  unsigned int nfailed = 0; 
+  unsigned int ndropped = 0; 
+  unsigned int ncodes[WLN_ERR_MAX] = {0}; 
+
   char buffer[1024]; 
   while (readline(fp, buffer, 1024, 0)) {
-    if (ReadWLN(buffer, &mol))
-      conv.Write(&mol ,&std::cout);
-    else
-      fprintf(stdout, "NULL\n");
+    /* CR, form feed and a bare last line all leave a trailing newline */
+    unsigned int len = strlen(buffer); 
+    if (len && buffer[len-1] == '\n')
+      len--; 
+
+    if (opt_filter) {
+      /* anything the automaton cannot accept whole never reaches the parser */
+      if (!wlnfsm_accepts(buffer, len)) {
+        wln_output_line(&out, "NULL");
+        ndropped++; 
+        continue; 
+      }
+    }
+
+    if (opt_check) {
+      /* syntax only, valid lines are echoed back */
+      if (ValidateWLN(buffer)) {
+        wln_output_write(&out, buffer, len); 
+        wln_output_write(&out, "\n", 1); 
+        nread++; 
+      }
+      else {
+        const struct wln_parse_error *err = WLNLastError(); 
+        char line[64]; 
+        snprintf(line, 64, "NULL\t%lu\t%s", (unsigned long)err->offset, WLNErrorString(err->code));
+        wln_output_line(&out, line); 
+        ncodes[err->code]++; 
+        nfailed++; 
+      }
+    }
+    else if (ReadWLN(buffer, &mol)) {
+      conv.Write(&mol, &os);
+      wln_output_end(&out); 
+      nread++; 
+    }
+    else {
+      wln_output_line(&out, "NULL");
+      ncodes[WLNLastError()->code]++; 
+      nfailed++; 
+    }
     mol.Clear(); 
   }
+
+  if (opt_filter)
+    fprintf(stderr, "%u lines dropped by the wln filter\n", ndropped); 
+
+  if (opt_verbose) {
+    fprintf(stderr, "%u read, %u failed\n", nread, nfailed); 
+    for (unsigned int c=1; c<WLN_ERR_MAX; c++) {
+      if (ncodes[c])
+        fprintf(stderr, "  %-28s %u\n", WLNErrorString(c), ncodes[c]); 
+    }
+  }
 }
 
 
@@ -106,8 +195,12 @@ display_usage()
                   "with a C++ plug in function to OpenBabel\n\n");
   fprintf(stderr, "readwln <options> -o<format> [infile]\n");
   fprintf(stderr, "<options>\n");
+  fprintf(stderr, " -c                   check syntax only, echo valid lines and give the error offset of others\n");
+  fprintf(stderr, " -f                   drop lines the wln automaton rejects before parsing\n");
   fprintf(stderr, " -h                   show the help for executable usage\n");
+  fprintf(stderr, " -l                   flush output after every line, default when writing to a terminal\n");
   fprintf(stderr, " -o                   choose output format (-osmi, -oinchi, -okey, -ocan)\n");
+  fprintf(stderr, " -v                   log each parse error and print a summary on exit\n");
   exit(1);
 }
 
@@ -120,13 +213,21 @@ process_cml(int argc, char *argv[])
   
   fp = NULL; 
   format = (const char *)0;
+  opt_verbose = false; 
+  opt_check = false; 
+  opt_filter = false; 
+  opt_line_flush = isatty(STDOUT_FILENO); 
   
   j = 0; 
   for (i = 1; i < argc; i++) {
     ptr = argv[i];
     if (ptr[0] == '-' && ptr[1]) switch (ptr[1]) {
+      case 'c': opt_check = true; break;
+      case 'f': opt_filter = true; break;
       case 'h': display_usage(); 
+      case 'l': opt_line_flush = true; break;
       case 'o': format = ptr+2; break;
+      case 'v': opt_verbose = true; break;
       default:
         fprintf(stderr, "Error: unrecognised input %s\n", ptr);
         display_usage();
@@ -145,7 +246,7 @@ process_cml(int argc, char *argv[])
     } 
   }
 
-  if (!format) {
+  if (!format && !opt_check) {
     fprintf(stderr,"Error: no output format selected\n");
     display_usage();
   }
@@ -159,7 +260,13 @@ int
 main(int argc, char *argv[])
 {
   process_cml(argc, argv);
+  /* the reader parses C symbols, so its filter must accept them */
+  if (opt_filter)
+    wlnfsm_select(WLN_DIALECT_DEFAULT | WLN_DIALECT_C); 
+  WLNSetLogging(opt_verbose); 
+  wln_output_init(&out, STDOUT_FILENO, opt_line_flush); 
   process_file(fp); 
+  wln_output_free(&out); 
   if (fp != stdin)
     fclose(fp); 
   return 0;
@@ -28,14 +28,23 @@ GNU General Public License for more details.
 #include <openbabel/babelconfig.h>
 #include <openbabel/obconversion.h>
 
+/* test hooks, only compiled into wlnreader.cpp with WLN_TEST_HOOKS */
+bool WLNTestAcyclic(const char *buffer); 
+void WLNTestChainPath(bool enable); 
+
 bool opt_verbose; 
 bool opt_early_stop; 
 bool opt_read; 
+bool opt_chain; 
+bool opt_api; 
 
 unsigned int n_reads;
 unsigned int n_writes;
+unsigned int n_checks;
+unsigned int n_failed;
 
 #define BENCH_N 417
+#define CHAIN_REPEAT 1000
 
 const char *wln_bench[BENCH_N]  = 
 {
@@ -968,14 +977,387 @@ static void run_wln_write_test() {
 }
 
 
+/* counts an api check, printing the notation if it failed */
+static void api_check(bool ok, const char *what, const char *wln) {
+  n_checks++; 
+  if (!ok) {
+    printf("failed\t%s\t%s\n", what, wln); 
+    n_failed++; 
+  }
+}
+
+
+/* the molecule as a string, reads are compared through this */
+static std::string mol_string(OpenBabel::OBMol *mol) {
+  OpenBabel::OBConversion conv;
+  conv.SetOutFormat("can");
+  return conv.WriteString(mol, true); 
+}
+
+
+static void batch_read_callback(unsigned int record, bool ok, OpenBabel::OBMol *mol, void *data) {
+  std::string *out = (std::string*)data; 
+  out[record] = ok ? mol_string(mol) : "null read"; 
+}
+
+
+/* batch reads of the bench, serial and threaded, must match one ReadWLN each */
+static void check_read_batch() {
+  OpenBabel::OBMol mol;
+  std::string serial[BENCH_N]; 
+  std::string batch[BENCH_N]; 
+  size_t offsets[BENCH_N+1]; 
+  std::string buffer; 
+
+  unsigned int nserial = 0; 
+  for (unsigned int i = 0; i < BENCH_N; i++) {
+    offsets[i] = buffer.size(); 
+    buffer += wln_bench[i]; 
+    if (ReadWLN(wln_bench[i], &mol)) {
+      serial[i] = mol_string(&mol); 
+      nserial++; 
+    }
+    else 
+      serial[i] = "null read"; 
+    mol.Clear(); 
+  }
+  offsets[BENCH_N] = buffer.size(); 
+
+  const unsigned int nthreads[2] = {1, 4}; 
+  for (unsigned int t = 0; t < 2; t++) {
+    struct wln_batch_summary summary; 
+    const unsigned int nread = ReadWLNBatch(buffer.c_str(), offsets, BENCH_N, batch_read_callback, batch, 
+                                            nthreads[t], &summary); 
+    api_check(nread == nserial && summary.nread == nserial && summary.nfailed == BENCH_N - nserial, 
+              "ReadWLNBatch count", "bench"); 
+    for (unsigned int i = 0; i < BENCH_N; i++)
+      api_check(batch[i] == serial[i], "ReadWLNBatch", wln_bench[i]); 
+  }
+}
+
+
+/* batch writes of the read bench must match one WriteWLNString each, byte for byte */
+static void check_write_batch() {
+  OpenBabel::OBMol *mols[BENCH_N]; 
+  const char *names[BENCH_N]; 
+  std::string serial[BENCH_N]; 
+  size_t offsets[BENCH_N+1]; 
+  
+  char *buffer = NULL; 
+  size_t nbuffer = 0; 
+  unsigned int nmols = 0; 
+  unsigned int nserial = 0; 
+  for (unsigned int i = 0; i < BENCH_N; i++) {
+    OpenBabel::OBMol *mol = new OpenBabel::OBMol; 
+    if (!ReadWLN(wln_bench[i], mol)) {
+      delete mol; 
+      continue; 
+    }
+    const long len = WriteWLNString(&buffer, &nbuffer, mol); 
+    serial[nmols] = len < 0 ? "" : std::string(buffer, len); 
+    nserial += len >= 0; 
+    names[nmols] = wln_bench[i]; 
+    mols[nmols++] = mol; 
+  }
+
+  const unsigned int nthreads[2] = {1, 4}; 
+  for (unsigned int t = 0; t < 2; t++) {
+    const unsigned int nwritten = WriteWLNBatch(mols, nmols, &buffer, &nbuffer, offsets, nthreads[t]); 
+    api_check(nwritten == nserial && offsets[0] == 0, "WriteWLNBatch count", "bench"); 
+    for (unsigned int i = 0; i < nmols; i++) {
+      const std::string written(buffer + offsets[i], offsets[i+1] - offsets[i]); 
+      api_check(written == serial[i], "WriteWLNBatch", names[i]); 
+    }
+  }
+
+  for (unsigned int i = 0; i < nmols; i++)
+    delete mols[i]; 
+  free(buffer); 
+}
+
+
+#define CHAIN_FOLD_N 8
+
+/* chains of ten or more carbons, the writer once wrote their digits reversed */
+const char *chain_fold_bench[CHAIN_FOLD_N] = 
+{
+  "10H",
+  "22H",
+  "Z11Z",
+  "QV19Q",
+  "19YQM1",
+  "12N3&2",
+  "12SW12",
+  "QVY19&2Q"
+};
+
+
+/* written chains must read back to the same number of atoms */
+static void check_chain_fold() {
+  OpenBabel::OBMol mol;
+  OpenBabel::OBMol written_mol;
+  char *buffer = NULL; 
+  size_t nbuffer = 0; 
+
+  for (unsigned int i = 0; i < CHAIN_FOLD_N; i++) {
+    const char *ptr = chain_fold_bench[i]; 
+    bool ok = ReadWLN(ptr, &mol) && 
+              WriteWLNString(&buffer, &nbuffer, &mol) >= 0 && 
+              ReadWLN(buffer, &written_mol) && 
+              written_mol.NumAtoms() == mol.NumAtoms(); 
+    api_check(ok, "chain fold", ptr); 
+    mol.Clear(); 
+    written_mol.Clear(); 
+  }
+  free(buffer); 
+}
+
+
+/* acyclic strings must read the same by the chain only path as by the general parse */
+static void check_chain_path() {
+  OpenBabel::OBMol mol;
+  for (unsigned int i = 0; i < BENCH_N; i++) {
+    const char *ptr = wln_bench[i];
+    if (!WLNTestAcyclic(ptr))
+      continue; 
+
+    bool chain_ok = ReadWLN(ptr, &mol); 
+    const std::string chain = chain_ok ? mol_string(&mol) : ""; 
+    mol.Clear(); 
+
+    WLNTestChainPath(false); 
+    bool general_ok = ReadWLN(ptr, &mol); 
+    const std::string general = general_ok ? mol_string(&mol) : ""; 
+    mol.Clear(); 
+    WLNTestChainPath(true); 
+
+    api_check(chain_ok == general_ok && chain == general, "chain path", ptr); 
+  }
+}
+
+
+/* times the acyclic strings from the read bench on the chain only path against the general parse */
+static unsigned long time_chain_reads(unsigned int *n_chains, unsigned int *n_failed) {
+  OpenBabel::OBMol mol;
+  struct timeval stop, start;
+  gettimeofday(&start, NULL);
+
+  *n_chains = 0; 
+  *n_failed = 0; 
+  for (unsigned int r = 0; r < CHAIN_REPEAT; r++) {
+    for (unsigned int i = 0; i < BENCH_N; i++) {
+      const char *ptr = wln_bench[i];
+      if (!WLNTestAcyclic(ptr))
+        continue; 
+
+      if (r == 0)
+        (*n_chains)++; 
+      if (!ReadWLN(ptr, &mol) && r == 0)
+        (*n_failed)++; 
+      mol.Clear(); 
+    }
+  }
+
+  gettimeofday(&stop, NULL);
+  return (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec; 
+}
+
+
+static void run_wln_chain_bench() {
+  n_checks = 0; 
+  n_failed = 0; 
+  fprintf(stderr, "WLN Chain Read Benchmark\n"); 
+  
+  check_chain_path(); 
+  if (n_failed) {
+    fprintf(stderr, "%d/%d strings differ from the general parse\n", n_failed, n_checks); 
+    exit(1); 
+  }
+
+  unsigned int n_chains, n_read_failed; 
+  const unsigned long chain_us = time_chain_reads(&n_chains, &n_read_failed); 
+  WLNTestChainPath(false); 
+  const unsigned long general_us = time_chain_reads(&n_chains, &n_read_failed); 
+  WLNTestChainPath(true); 
+
+  const double nreads = n_chains * (double)CHAIN_REPEAT; 
+  fprintf(stderr, "%d acyclic compounds x %d, %d failed, all match the general parse\n", n_chains, CHAIN_REPEAT, n_read_failed); 
+  fprintf(stderr, "chain path took %lu us (%.1f ns per read)\n", chain_us, n_chains ? (chain_us * 1000.0) / nreads : 0.0);
+  fprintf(stderr, "general parse took %lu us (%.1f ns per read)\n", general_us, n_chains ? (general_us * 1000.0) / nreads : 0.0);
+  exit(0); 
+}
+
+
+#define ERROR_N 32
+
+struct error_case {
+  const char *wln; 
+  int code; 
+  size_t offset; 
+}; 
+
+/* failed reads and where they are reported, offsets are of the offending byte */
+const struct error_case error_bench[ERROR_N] = 
+{
+  {"1V1",     WLN_ERR_NONE,        0},
+  {"L6J",     WLN_ERR_NONE,        0},
+  {"L6TJ &",  WLN_ERR_NONE,        0},
+  {"",        WLN_ERR_EMPTY,       0},
+  {"&",       WLN_ERR_EMPTY,       0},
+  {"1V1%",    WLN_ERR_CHARACTER,   3},
+  {"L6%J",    WLN_ERR_CHARACTER,   2},
+  {"1A1",     WLN_ERR_SYMBOL,      1},
+  {"1V1J",    WLN_ERR_SYMBOL,      3},
+  {"1V1/2",   WLN_ERR_UNSUPPORTED, 3},
+  {"L6J Z1",  WLN_ERR_LOCANT,      4},
+  {"T6NJ Z1", WLN_ERR_LOCANT,      5},
+  {"R ZZ",    WLN_ERR_LOCANT,      2},
+  {"L6TTJ",   WLN_ERR_RING,        3},
+  {"1V1 ",    WLN_ERR_RING,        3},
+  {"1V1&&",   WLN_ERR_TRAILING,    4},
+  {"L6J&",    WLN_ERR_TRAILING,    3},
+  {"Z1&Q",    WLN_ERR_TRAILING,    3},
+  {"-",       WLN_ERR_SYMBOL,      0},
+
+  /* locants past the ring path, these once crashed the read */
+  {"T56 KMJ BO&",  WLN_ERR_LOCANT, 5},
+  {"TOM C ENJ",    WLN_ERR_RING,   1},
+  {"T CNJ",        WLN_ERR_RING,   3},
+  {"LVVV",         WLN_ERR_RING,   1},
+  {"LJ",           WLN_ERR_RING,   1},
+  {"L999999999J",  WLN_ERR_RING,   10},
+  {"L6 9ABJ",      WLN_ERR_RING,   6},
+  {"L E6 C6666 T6 S6 2AT EV", WLN_ERR_LOCANT, 22},
+
+  /* spaces that open no locant, these once only gave the catch all syntax code */
+  {"L6 %J",        WLN_ERR_LOCANT, 3},
+  {"T6N %J",       WLN_ERR_LOCANT, 5},
+  {"L6J B- A1",    WLN_ERR_RING,   8},
+  {"L6J ",         WLN_ERR_LOCANT, 3},
+
+  /* chain runs past what one number may build */
+  {"70000",        WLN_ERR_UNSUPPORTED, 4}
+};
+
+
+/* the error record of every case, and the batch tally of the failures */
+static void check_errors() {
+  OpenBabel::OBMol mol;
+  std::string buffer; 
+  size_t offsets[ERROR_N+1]; 
+  unsigned int ncodes[WLN_ERR_MAX] = {0}; 
+
+  for (unsigned int i = 0; i < ERROR_N; i++) {
+    const struct error_case *c = &error_bench[i]; 
+    const bool ok = ReadWLN(c->wln, &mol); 
+    const struct wln_parse_error *err = WLNLastError(); 
+    api_check(ok == (c->code == WLN_ERR_NONE) && err->code == c->code, "error code", c->wln); 
+    if (!ok) {
+      api_check(err->offset == c->offset && err->ch == (unsigned char)c->wln[c->offset], "error offset", c->wln); 
+      ncodes[c->code]++; 
+    }
+    mol.Clear(); 
+
+    offsets[i] = buffer.size(); 
+    buffer += c->wln; 
+  }
+  offsets[ERROR_N] = buffer.size(); 
+
+  struct wln_batch_summary summary; 
+  ReadWLNBatch(buffer.c_str(), offsets, ERROR_N, NULL, NULL, 1, &summary); 
+  for (unsigned int code = 0; code < WLN_ERR_MAX; code++)
+    api_check(summary.ncodes[code] == ncodes[code], "ReadWLNBatch error tally", WLNErrorString(code)); 
+}
+
+
+/* validation is the read without a molecule, both must give the same record */
+static void check_validate_one(const char *wln) {
+  OpenBabel::OBMol mol;
+  const bool ok = ReadWLN(wln, &mol); 
+  const struct wln_parse_error read_err = *WLNLastError(); 
+  const bool valid = ValidateWLN(wln); 
+  const struct wln_parse_error *err = WLNLastError(); 
+  api_check(valid == ok && err->code == read_err.code, "ValidateWLN against ReadWLN", wln); 
+  if (!ok) 
+    api_check(err->offset == read_err.offset, "ValidateWLN error offset", wln); 
+}
+
+
+static void check_validate() {
+  for (unsigned int i = 0; i < BENCH_N; i++) 
+    check_validate_one(wln_bench[i]); 
+  for (unsigned int i = 0; i < ERROR_N; i++) 
+    check_validate_one(error_bench[i].wln); 
+}
+
+
+/* bare ring locants each take a methyl and the longest chain run, neither in the bench */
+#define ESTIMATE_N 5
+const char *estimate_bench[ESTIMATE_N] = 
+{
+  "L6TJ A B",
+  "L6J A B C D E F",
+  "T6NJ B C",
+  "L66J A B C",
+  "65535"
+};
+
+
+/* the estimate is an upper bound, bonds are counted from the atoms that hold them */
+static bool check_estimate_one(const char *ptr) {
+  OpenBabel::OBMol mol;
+  unsigned int nbonds_bound = 0; 
+  const unsigned int natoms_bound = EstimateWLN(ptr, &nbonds_bound); 
+  if (!ReadWLN(ptr, &mol)) 
+    return false; 
+
+  unsigned int degrees = 0; 
+  FOR_ATOMS_OF_MOL(a, &mol)
+    degrees += a->GetExplicitDegree(); 
+
+  api_check(mol.NumAtoms() <= natoms_bound, "EstimateWLN atoms", ptr); 
+  api_check(degrees / 2 <= nbonds_bound, "EstimateWLN bonds", ptr); 
+  api_check(EstimateWLN(ptr, NULL) == natoms_bound, "EstimateWLN without bonds", ptr); 
+  return true; 
+}
+
+
+static void check_estimate() {
+  for (unsigned int i = 0; i < BENCH_N; i++) 
+    check_estimate_one(wln_bench[i]); 
+  for (unsigned int i = 0; i < ESTIMATE_N; i++) 
+    api_check(check_estimate_one(estimate_bench[i]), "EstimateWLN read", estimate_bench[i]); 
+}
+
+
+static void run_wln_api_test() {
+  n_checks = 0; 
+  n_failed = 0; 
+  fprintf(stderr, "WLN API Test\n"); 
+
+  check_read_batch(); 
+  check_write_batch(); 
+  check_chain_fold(); 
+  check_chain_path(); 
+  check_estimate(); 
+  check_errors(); 
+  check_validate(); 
+
+  fprintf(stderr, "%d/%d checks passed\n", n_checks - n_failed, n_checks); 
+  exit(n_failed ? 1 : 0); 
+}
+
+
 static void 
 display_usage() {
   fprintf(stderr, "usage:\n"
-                  "  testwln [-e] [-w|-r]\n"
+                  "  testwln [-e] [-w|-r|-c|-a]\n"
                   "options:\n"
                   "  -e\tearly stop, if error, print string and early stop\n"
                   "  -w\tperform the write test\n"
                   "  -r\tperform the read test (default)\n"
+                  "  -c\tbenchmark the chain only read path against the general parse\n"
+                  "  -a\tcheck the api calls against the serial read and write\n"
       ); 
   exit(1); 
 }
@@ -989,6 +1371,8 @@ process_cml(int argc, char *argv[])
   opt_verbose = false; 
   opt_early_stop = false; 
   opt_read = true; 
+  opt_chain = false; 
+  opt_api = false; 
 
   for (i = 1; i < argc; i++) {
     ptr = argv[i];
@@ -997,6 +1381,8 @@ process_cml(int argc, char *argv[])
       case 'v': opt_verbose    = true; break; 
       case 'r': opt_read = true; break; 
       case 'w': opt_read = false; break; 
+      case 'c': opt_chain = true; break; 
+      case 'a': opt_api = true; break; 
       case 'h':
         display_usage(); 
 
@@ -1011,6 +1397,11 @@ process_cml(int argc, char *argv[])
 int main(int argc, char *argv[])
 {
   process_cml(argc, argv); 
+  WLNSetLogging(opt_verbose); 
+  if (opt_chain)
+    run_wln_chain_bench(); 
+  if (opt_api)
+    run_wln_api_test(); 
   opt_read ? run_wln_read_test() : run_wln_write_test(); 
   return 0; 
 }
@@ -0,0 +1,126 @@
+#!/bin/sh
+# wlngrep checks, every match of the exact scan must come out of --ocr too,
+# -j must give the serial output, and -x, -n, -b, --json and --top their known results
+# usage: testwlngrep.sh <wlngrep>
+
+WLNGREP=${1:-wlngrep}
+fail=0
+ntests=0
+
+tmp=${TMPDIR:-/tmp}/testwlngrep.$$
+trap 'rm -f $tmp.*' EXIT
+
+# text around WLN, including candidates the corrected scan once ran over
+cat > $tmp.in <<'EOF'
+compound L66J 8Z here
+mg/kg prepared L666/GL 2AF LTJ
+the product 3DEI was dried
+added QVR then L6TJ AR
+WN R DG at 0.5 mM, T56 BMJ D1 and OV1
+ZR DQ; 1V1 and L C666 BV IVJ in 5 B0 J A- AL5 B0J CG
+EOF
+printf 'tail without newline L66J 8Z' >> $tmp.in
+
+check_superset()
+{
+  ntests=$((ntests+1))
+  $WLNGREP -b -o $1 $tmp.in | sort -u > $tmp.exact
+  $WLNGREP -b -o --ocr$2 $1 $tmp.in | sed 's/	[0-9]*$//' | sort -u > $tmp.ocr
+  missing=$(comm -23 $tmp.exact $tmp.ocr)
+  if [ -n "$missing" ]; then
+    echo "failed: --ocr$2 $1 misses exact matches:"
+    echo "$missing"
+    fail=$((fail+1))
+  fi
+}
+
+check_superset "" ""
+check_superset "" "=2"
+check_superset "--permissive" ""
+check_superset "--strict" ""
+
+# output must equal the expected text in $tmp.want
+check_expect()
+{
+  ntests=$((ntests+1))
+  if ! diff $tmp.want $tmp.got > $tmp.diff; then
+    echo "failed: $1"
+    cat $tmp.diff
+    fail=$((fail+1))
+  fi
+}
+
+# -x takes LF and CRLF lines, a CR followed by anything else ends the line
+printf 'L66J\nL6TJ\r\nL66J\rX\nnot wln\n1V1\r\r\nT56 BMJ D1' > $tmp.x
+printf 'L66J\nL6TJ\nT56 BMJ D1\n' > $tmp.want
+$WLNGREP -x $tmp.x > $tmp.got
+check_expect "-x lines"
+$WLNGREP -j2 -x $tmp.x > $tmp.got
+check_expect "-j -x lines"
+printf '1:0:L66J\n2:5:L6TJ\n6:32:T56 BMJ D1\n' > $tmp.want
+$WLNGREP -x -n -b -o $tmp.x > $tmp.got
+check_expect "-x line numbers and offsets"
+
+# known offsets and line numbers, and a file name json has to escape
+jpath="$tmp.j\"q\\s"
+printf 'x L66J y\nnone\n\n  1V1 and T56 BMJ D1\n' > "$jpath"
+printf '1:2:L66J\n4:17:1V1\n4:25:T56 BMJ D1\n' > $tmp.want
+$WLNGREP -n -b -o "$jpath" > $tmp.got
+check_expect "-n -b offsets"
+$WLNGREP -j2 -n -b -o "$jpath" > $tmp.got
+check_expect "-j -n -b offsets"
+
+jfile=$(printf '%s' "$jpath" | sed 's/\\/\\\\/g; s/"/\\"/g')
+printf '{"file":"%s","offset":2,"line":1,"match":"L66J"}\n' "$jfile" > $tmp.want
+printf '{"file":"%s","offset":17,"line":4,"match":"1V1"}\n' "$jfile" >> $tmp.want
+printf '{"file":"%s","offset":25,"line":4,"match":"T56 BMJ D1"}\n' "$jfile" >> $tmp.want
+$WLNGREP --json "$jpath" > $tmp.got
+check_expect "--json records"
+$WLNGREP -j2 --json "$jpath" > $tmp.got
+check_expect "-j --json records"
+
+# past the 16 MB chunk size, so -j splits the file on sync bytes and lines
+cat $tmp.in $tmp.x > $tmp.big
+printf '\n' >> $tmp.big
+i=0
+while [ $i -lt 17 ]; do
+  cat $tmp.big $tmp.big > $tmp.dbl
+  mv $tmp.dbl $tmp.big
+  i=$((i+1))
+done
+
+check_parallel()
+{
+  $WLNGREP $1 $tmp.big > $tmp.want
+  $WLNGREP -j4 $1 $tmp.big > $tmp.got
+  check_expect "-j4 $1 differs from the serial scan"
+}
+
+check_parallel ""
+check_parallel "-c"
+check_parallel "-o -b"
+check_parallel "-o -n"
+check_parallel "--json"
+check_parallel "-x"
+check_parallel "-x -n -b"
+
+# fewer distinct matches than k, so the merged summaries must be exact
+count_matches()
+{
+  sort | uniq -c | awk '{ match($0, /^ *[0-9]+ /); printf "%s\t%s\n", $1, substr($0, RLENGTH+1) }' | sort
+}
+
+$WLNGREP -o $tmp.big | count_matches > $tmp.want
+$WLNGREP --top 1000 $tmp.big | sort > $tmp.got
+check_expect "--top counts"
+$WLNGREP -j4 --top 1000 $tmp.big | sort > $tmp.got
+check_expect "-j --top counts across chunks"
+
+cp $tmp.in $tmp.in2
+cp $tmp.x $tmp.x2
+for f in $tmp.in $tmp.in2 $tmp.x $tmp.x2; do $WLNGREP -o $f; done | count_matches > $tmp.want
+$WLNGREP -j4 --top 1000 $tmp.in $tmp.in2 $tmp.x $tmp.x2 | sort > $tmp.got
+check_expect "-j --top counts across files"
+
+echo "$((ntests-fail))/$ntests checks passed"
+[ $fail -eq 0 ]
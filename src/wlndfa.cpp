@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "wlndfa.h"
+
+/* the generated dialect tables, defined here once */
+#define WLN_DFA_TABLES
+#include "wlnfsm_tables.h"
+
+const struct wln_dfa *wlnfsm = &wlnfsm_dialects[WLN_DIALECT_DEFAULT]; 
+
+
+void wlnfsm_select(unsigned int dialect)
+{
+  wlnfsm = &wlnfsm_dialects[dialect % WLN_DIALECTS]; 
+}
+
+
+/* 
+ * the vector loops only rule bytes out on the start range, which holds the 
+ * dash, digits and capitals. Each candidate is confirmed against the root 
+ * row, so prose runs of lower case and punctuation are skipped in blocks.
+ */
+unsigned int wlnfsm_next_start(const char *buf, unsigned int i, unsigned int n)
+{
+#if defined(__AVX2__)
+  const __m256i lo  = _mm256_set1_epi8((char)wlnfsm->start_lo); 
+  const __m256i lim = _mm256_set1_epi8((char)(wlnfsm->start_hi - wlnfsm->start_lo)); 
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(buf + i)), lo); 
+    unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, lim), lim)); 
+    while (mask) {
+      unsigned int k = i + __builtin_ctz(mask); 
+      if (state_jmp(0, (unsigned char)buf[k]) != NO_JMP)
+        return k; 
+      mask &= mask - 1; 
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i lo  = _mm_set1_epi8((char)wlnfsm->start_lo); 
+  const __m128i lim = _mm_set1_epi8((char)(wlnfsm->start_hi - wlnfsm->start_lo)); 
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(buf + i)), lo); 
+    unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, lim), lim)); 
+    while (mask) {
+      unsigned int k = i + __builtin_ctz(mask); 
+      if (state_jmp(0, (unsigned char)buf[k]) != NO_JMP)
+        return k; 
+      mask &= mask - 1; 
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    if (state_jmp(0, (unsigned char)buf[i]) != NO_JMP)
+      return i; 
+  }
+  return n; 
+}
+
+
+bool wlnfsm_sync(unsigned char ch)
+{
+  return dfa_sync(wlnfsm, ch); 
+}
+
+
+bool wlnfsm_accepts(const char *str, unsigned int len)
+{
+  unsigned int curr_id = 0; 
+  for (unsigned int i=0; i<len; i++) {
+    curr_id = state_jmp(curr_id, (unsigned char)str[i]); 
+    if (curr_id == NO_JMP)
+      return false; 
+  }
+  return is_accept(curr_id); 
+}
+
+
+unsigned char wlnfsm_ocr_swap(unsigned char ch)
+{
+  switch (ch) {
+    case '0': return 'O'; 
+    case 'O': return '0'; 
+    case '1': return 'I'; 
+    case 'I': return '1'; 
+    case '5': return 'S'; 
+    case 'S': return '5'; 
+  }
+  return 0; 
+}
+
+
+/* every state of set moved on ch */
+static unsigned int fuzzy_jmp(unsigned int set, unsigned char ch)
+{
+  unsigned int next = 0; 
+  while (set) {
+    const unsigned int s = __builtin_ctz(set); 
+    const unsigned int t = state_jmp(s, ch); 
+    if (t != NO_JMP)
+      next |= 1u << t; 
+    set &= set - 1; 
+  }
+  return next; 
+}
+
+
+bool wlnfsm_fuzzy_step(const unsigned int *set, unsigned int *next, unsigned int budget, unsigned char ch)
+{
+  const unsigned char swap = wlnfsm_ocr_swap(ch); 
+  for (unsigned int e = 0; e <= budget; e++)
+    next[e] = 0; 
+
+  for (unsigned int e = 0; e <= budget; e++) {
+    if (!set[e])
+      continue; 
+    next[e] |= fuzzy_jmp(set[e], ch); 
+    if (e < budget) {
+      const unsigned int spaced = fuzzy_jmp(set[e], ' '); 
+      next[e+1] |= fuzzy_jmp(spaced, ch); 
+      if (swap)
+        next[e+1] |= fuzzy_jmp(set[e], swap); 
+      if (swap && e+1 < budget)
+        next[e+2] |= fuzzy_jmp(spaced, swap); 
+    }
+  }
+
+  unsigned int live = 0; 
+  for (unsigned int e = 0; e <= budget; e++)
+    live |= next[e]; 
+  return live; 
+}
+
+
+int wlnfsm_fuzzy_accept(const unsigned int *set, unsigned int budget)
+{
+  for (unsigned int e = 0; e <= budget; e++) {
+    for (unsigned int m = set[e]; m; m &= m - 1) {
+      if (is_accept(__builtin_ctz(m)))
+        return e; 
+    }
+  }
+  return -1; 
+}
+
+
+/* 
+ * walks back from an accepting state, at each byte taking any state of the 
+ * earlier sets that reaches the current one. The sets only hold reachable 
+ * states so one always exists, and the edit counts add up to the fewest. 
+ */
+unsigned int wlnfsm_fuzzy_correct(const char *str, unsigned int len, 
+                                  const unsigned int (*sets)[WLN_FUZZY_MAX+1], 
+                                  unsigned int budget, char *out)
+{
+  static const unsigned int root[WLN_FUZZY_MAX+1] = {1u}; 
+
+  unsigned int e = wlnfsm_fuzzy_accept(sets[len-1], budget); 
+  unsigned int curr_id = 0; 
+  for (unsigned int m = sets[len-1][e]; m; m &= m - 1) {
+    curr_id = __builtin_ctz(m); 
+    if (is_accept(curr_id))
+      break; 
+  }
+
+  unsigned int n = 2*len; 
+  for (unsigned int p = len; p-- > 0;) {
+    const unsigned char ch = str[p]; 
+    const unsigned char swap = wlnfsm_ocr_swap(ch); 
+    const unsigned int *prev = p ? sets[p-1] : root; 
+
+    /* exact, swapped, spaced and both, in order of cost */
+    for (unsigned int op = 0; op < 4; op++) {
+      const unsigned int cost = (op & 1) + (op >> 1); 
+      const unsigned char read = op & 1 ? swap : ch; 
+      if ((op & 1 && !swap) || cost > e)
+        continue; 
+
+      unsigned int m = prev[e - cost]; 
+      for (; m; m &= m - 1) {
+        unsigned int s = __builtin_ctz(m); 
+        if (op >> 1 && (s = state_jmp(s, ' ')) == NO_JMP)
+          continue; 
+        if (state_jmp(s, read) == curr_id)
+          break; 
+      }
+      if (!m)
+        continue; 
+
+      out[--n] = read; 
+      if (op >> 1)
+        out[--n] = ' '; 
+      curr_id = __builtin_ctz(m); 
+      e -= cost; 
+      break; 
+    }
+  }
+
+  memmove(out, out+n, 2*len-n); 
+  return 2*len-n; 
+}
@@ -0,0 +1,84 @@
+#ifndef WLN_DFA_H
+#define WLN_DFA_H
+
+#include <stdbool.h>
+
+/* 
+ * compiled WLN recogniser, one table lookup per byte. State 0 is the root 
+ * and NO_JMP marks a byte with no transition. 
+ *
+ * The tables are generated at build time by wlndfagen, minimised and with 
+ * bytes that behave the same in every state sharing a class. Transitions 
+ * are 8 bit state ids per class in rows padded to a power of two, constant 
+ * and read only with no start up cost. 
+ *
+ * One automaton is built for every grammar dialect, all with the same 
+ * layout, and wlnfsm points at the one in use. The C symbol is left out of 
+ * the default, as C chains otherwise match most SMILES. 
+ */
+
+#include "wlnfsm_tables.h"
+
+#define NO_JMP 0xff
+
+struct wln_dfa {
+  unsigned char nstates; 
+  unsigned char nclasses; 
+  unsigned char start_lo;  // every byte leaving the root lies in [start_lo, start_hi]
+  unsigned char start_hi; 
+  unsigned char sync_class; // class of the bytes with no transition in any state
+  unsigned char cls[256]; 
+  unsigned char jmp[WLN_DFA_NSTATES * WLN_DFA_STRIDE]; 
+  unsigned char final[WLN_DFA_NSTATES]; 
+  unsigned char lane[(WLN_DFA_NSTATES + 1) * WLN_DFA_STRIDE]; // total form, see wlndfagen
+}; 
+
+extern const struct wln_dfa *wlnfsm; 
+
+/* hot loops keep the table in a local, byte stores would force a reload */
+#define dfa_accept(fsm,x) (fsm)->final[x]
+#define dfa_jmp(fsm,x,ch) (fsm)->jmp[(x) * WLN_DFA_STRIDE + (fsm)->cls[ch]]
+#define dfa_sync(fsm,ch) ((fsm)->cls[ch] == (fsm)->sync_class)
+#define dfa_lane(fsm,x,ch) (fsm)->lane[(x) * WLN_DFA_STRIDE + (fsm)->cls[ch]]
+
+#define is_accept(x) dfa_accept(wlnfsm,x)
+#define state_jmp(x,ch) dfa_jmp(wlnfsm,x,ch)
+
+/* selects the automaton for a set of WLN_DIALECT_* bits, default on startup */
+void wlnfsm_select(unsigned int dialect); 
+
+/* index of the next byte in [i, n) that leaves the root state, n if none */
+unsigned int wlnfsm_next_start(const char *buf, unsigned int i, unsigned int n); 
+
+/* true if ch has no transition in any state, the scan is always back at root */
+bool wlnfsm_sync(unsigned char ch); 
+
+/* true if the automaton accepts all len bytes of str from the root */
+bool wlnfsm_accepts(const char *str, unsigned int len); 
+
+/* 
+ * error tolerant form for OCR'd text, one bit mask of live states per edit 
+ * count. An edit is one of the common OCR confusions swapped back or a 
+ * dropped space put back, the generator keeps every automaton small enough 
+ * for its states to fit a mask. 
+ */
+#define WLN_FUZZY_MAX 3  // largest edit budget
+
+/* the character ch is mistaken for by OCR, 0 if none */
+unsigned char wlnfsm_ocr_swap(unsigned char ch); 
+
+/* advances the sets of each edit count on ch, false if nothing is left */
+bool wlnfsm_fuzzy_step(const unsigned int *set, unsigned int *next, unsigned int budget, unsigned char ch); 
+
+/* fewest edits of an accepting state in the sets, -1 if none */
+int wlnfsm_fuzzy_accept(const unsigned int *set, unsigned int budget); 
+
+/* 
+ * writes the corrected form of the len accepted bytes of str to out, which 
+ * holds 2*len. sets[p] are the sets after byte p, the first from the root. 
+ */
+unsigned int wlnfsm_fuzzy_correct(const char *str, unsigned int len, 
+                                  const unsigned int (*sets)[WLN_FUZZY_MAX+1], 
+                                  unsigned int budget, char *out); 
+
+#endif
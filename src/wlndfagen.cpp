@@ -0,0 +1,587 @@
+/*
+ * wlndfagen, writes the wln recogniser as a constant table header. Runs at 
+ * build time, the grammar below is expanded into a full width automaton, 
+ * pruned, minimised, and folded into byte classes so the tools start with 
+ * no setup and share the tables read only. 
+ *
+ * Every combination of the dialect bits is written out, the tools pick one
+ * at startup and the scan loop itself never branches on the dialect. 
+ *
+ * usage: wlndfagen <header>
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define NO_JMP 0xff
+#define WLN_DFA_STATES 64
+#define WLN_DFA_CLASSES 32
+
+/* grammar dialects, kept in step with the generated header */
+#define WLN_DIALECT_C           0x1  // the C symbol, conflicts with SMILES chains
+#define WLN_DIALECT_IONS        0x2  // ionic ' &' separated components
+#define WLN_DIALECT_SPIRO       0x4  // inline spiro '-&' ring definitions
+#define WLN_DIALECT_MULTICYCLIC 0x8  // multicyclic ring block locant lists
+#define WLN_DIALECTS            16
+#define WLN_DIALECT_DEFAULT     (WLN_DIALECT_IONS | WLN_DIALECT_SPIRO | WLN_DIALECT_MULTICYCLIC)
+
+/* 
+ * the lane table is the automaton made total for scans that never leave 
+ * the table. An extra idle state stands for the root between candidates, 
+ * a failed transition restarts on the same byte from the root and the 
+ * flags mark where candidates end and begin. Accepts are flagged as well, 
+ * except on a candidate's first byte which the scan never reports. 
+ */
+#define WLN_LANE_FAIL   0x80
+#define WLN_LANE_START  0x40
+#define WLN_LANE_ACCEPT 0x20
+#define WLN_LANE_STATE  0x1f
+
+struct fsm_state {
+  bool final; 
+  unsigned short jmp[256]; 
+};  
+
+static struct fsm_state wlnfsm[WLN_DFA_STATES]; 
+static unsigned short nstates; 
+static unsigned int dialect; 
+
+
+static unsigned short state_init()
+{
+  if (nstates == WLN_DFA_STATES) {
+    fprintf(stderr, "Error: wln automaton needs more than %d states\n", WLN_DFA_STATES); 
+    exit(1); 
+  }
+  wlnfsm[nstates].final = false; 
+  memset(wlnfsm[nstates].jmp, 0xff, sizeof(unsigned short)*256); 
+  return nstates++; 
+}
+
+#define make_accept(x) wlnfsm[x].final = true
+#define make_jmp(dst,src,ch) wlnfsm[src].jmp[ch] = dst
+
+
+static void make_symbol_transitions(unsigned int dst_id, unsigned int src_id)
+{
+	make_jmp(dst_id, src_id, 'B');
+
+  // The C symbol in WLN is rare, and adding C as a potential 
+  // match token directly conflicts with SMILES. e.g most normal 
+  // organic SMILES will match due to C chains. Omitting this token
+  // here as default, can be generated to match C symbols.
+	if (dialect & WLN_DIALECT_C)
+    make_jmp(dst_id, src_id, 'C');
+	
+  make_jmp(dst_id, src_id, 'E');
+	make_jmp(dst_id, src_id, 'F');
+	make_jmp(dst_id, src_id, 'G');
+	make_jmp(dst_id, src_id, 'H');
+	make_jmp(dst_id, src_id, 'I');
+	make_jmp(dst_id, src_id, 'K');
+	make_jmp(dst_id, src_id, 'M');
+	make_jmp(dst_id, src_id, 'N');
+	make_jmp(dst_id, src_id, 'O');
+	make_jmp(dst_id, src_id, 'P');
+	make_jmp(dst_id, src_id, 'Q');
+	make_jmp(dst_id, src_id, 'R');
+	make_jmp(dst_id, src_id, 'S');
+	make_jmp(dst_id, src_id, 'U');
+	make_jmp(dst_id, src_id, 'V');
+	make_jmp(dst_id, src_id, 'W');
+	make_jmp(dst_id, src_id, 'X');
+	make_jmp(dst_id, src_id, 'Y');
+	make_jmp(dst_id, src_id, 'Z');
+}
+
+
+static void build_wlnfsm() 
+{
+  nstates = 0; 
+  const unsigned int head        = state_init(); 
+
+  const unsigned int chain_open  = state_init(); 
+  const unsigned int locant_space = state_init(); 
+  
+  make_accept(chain_open); 
+  make_symbol_transitions(chain_open, head); 
+  make_symbol_transitions(chain_open, chain_open); 
+
+  for (unsigned char ch='0'; ch <= '9'; ch++) {
+    make_jmp(chain_open, head, ch); 
+    make_jmp(chain_open, chain_open, ch); 
+  }
+
+  make_jmp(chain_open, chain_open, '&'); 
+  
+  const unsigned int dash_open  = state_init();
+  const unsigned int dash_elem  = state_init();
+  const unsigned int dash_close = state_init();
+
+  /* generic elemental characters */
+  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) {
+    make_jmp(dash_elem, dash_open, ch); 
+    make_jmp(dash_close, dash_elem, ch); 
+  }
+  
+  make_jmp(dash_open, head, '-'); 
+  make_jmp(dash_open, chain_open, '-'); 
+  make_jmp(chain_open, dash_close, '-'); 
+
+  /* cyclic internal block states */
+
+  const unsigned int ring_open   = state_init(); 
+  const unsigned int ring_close  = state_init(); 
+  const unsigned int ring_digits = state_init(); 
+
+  make_accept(ring_close); 
+
+  make_jmp(ring_open, head, 'L');  
+  make_jmp(ring_open, head, 'T');  
+
+  for (unsigned char ch = '0'; ch <= '9'; ch++) {
+    make_jmp(ring_digits, ring_open, ch);
+    make_jmp(ring_digits, ring_digits, ch);
+  }
+
+  make_jmp(ring_close, ring_digits, 'J'); 
+
+  const unsigned int digit_space  = state_init(); 
+  const unsigned int digit_locant = state_init(); 
+  
+  /* ring digit locants and bridge atoms */
+  make_jmp(digit_space, ring_open, ' '); 
+  make_jmp(digit_space, ring_digits, ' '); 
+  
+  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) 
+    make_jmp(digit_locant, digit_space, ch); 
+  make_jmp(digit_locant, digit_locant, '&'); 
+
+  make_jmp(digit_space, digit_locant, ' '); 
+
+  for (unsigned char ch = '0'; ch <= '9'; ch++) 
+    make_jmp(ring_digits,digit_locant, ch); 
+  
+  make_jmp(ring_close, digit_locant, 'J'); 
+
+  /* multicyclic ring block defintion */
+  // n, locants, space, size
+
+  const unsigned int multi_digit    = state_init(); 
+  const unsigned int multi_locants  = state_init(); 
+  const unsigned int multi_break    = state_init(); 
+  const unsigned int multi_size     = state_init(); 
+  /* states past a dialect's entry are left unreachable and pruned */
+  for (unsigned char ch = '0'; ch <= '9'; ch++) {
+    if (dialect & WLN_DIALECT_MULTICYCLIC)
+      make_jmp(multi_digit, digit_space, ch); 
+    make_jmp(multi_digit, multi_digit, ch); 
+  }
+
+  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) {
+    make_jmp(multi_locants, multi_digit, ch); 
+    make_jmp(multi_locants, multi_locants, ch); 
+  }
+  make_jmp(multi_locants, multi_locants, '&'); 
+  make_jmp(multi_break, multi_locants, ' '); 
+
+  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) 
+    make_jmp(multi_size, multi_break, ch); 
+  make_jmp(multi_size, multi_size, '&'); 
+  
+  make_jmp(ring_close, multi_size, 'J'); 
+
+  /* hetero element definitions */
+  const unsigned int ring_hetero        = state_init(); 
+  const unsigned int hetero_dash_open   = state_init(); 
+  const unsigned int hetero_dash_elem_a = state_init(); 
+  const unsigned int hetero_dash_elem_b = state_init(); 
+  const unsigned int hetero_dash_close  = state_init(); 
+  const unsigned int hetero_space       = state_init(); 
+  const unsigned int hetero_locant      = state_init(); 
+
+  make_symbol_transitions(ring_hetero, ring_digits); 
+  make_symbol_transitions(ring_hetero, digit_locant); 
+  make_symbol_transitions(ring_hetero, multi_size); 
+  make_symbol_transitions(ring_hetero, ring_hetero); 
+  make_symbol_transitions(ring_hetero, hetero_locant); 
+  make_symbol_transitions(ring_hetero, hetero_dash_close); 
+
+  make_jmp(hetero_dash_open, ring_digits, '-'); 
+  make_jmp(hetero_dash_open, digit_locant, '-'); 
+  make_jmp(hetero_dash_open, multi_size, '-'); 
+  make_jmp(hetero_dash_open, ring_hetero, '-'); 
+  make_jmp(hetero_dash_open, hetero_locant, '-'); 
+
+  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) {
+    make_jmp(hetero_dash_elem_a, hetero_dash_open, ch); 
+    make_jmp(hetero_dash_elem_b, hetero_dash_elem_a, ch); 
+  }
+  make_jmp(hetero_dash_close, hetero_dash_elem_b, '-'); 
+
+  make_jmp(hetero_space, multi_size, ' '); 
+  make_jmp(hetero_space, ring_hetero, ' '); 
+
+  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) 
+    make_jmp(hetero_locant, hetero_space, ch); 
+
+  make_jmp(ring_close, hetero_dash_close, 'J'); 
+  make_jmp(hetero_space, hetero_dash_close, ' '); 
+  make_jmp(ring_close, ring_hetero, 'J'); 
+
+  make_jmp(ring_close, ring_close, '&'); 
+  
+  /* aromaticity assignments */
+  const unsigned int aromacity  = state_init(); 
+  make_jmp(ring_close, aromacity, 'J'); 
+  make_jmp(aromacity, aromacity, 'T'); 
+  make_jmp(aromacity, aromacity, '&'); 
+  
+  make_jmp(aromacity, ring_digits, 'T'); 
+  make_jmp(aromacity, ring_digits, '&'); 
+
+  make_jmp(aromacity, digit_locant, 'T'); 
+  make_jmp(aromacity, digit_locant, '&'); 
+
+  make_jmp(aromacity, multi_size, 'T'); 
+  make_jmp(aromacity, multi_size, '-'); 
+
+  make_jmp(aromacity, ring_hetero, 'T'); 
+  make_jmp(aromacity, ring_hetero, '&'); 
+
+  make_jmp(aromacity, hetero_dash_close, 'T'); 
+  make_jmp(aromacity, hetero_dash_close, '&'); 
+
+  /* ring locant jump into specific blocks */ 
+  const unsigned int rgroup_locant = state_init(); 
+
+  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) 
+    make_jmp(rgroup_locant, locant_space, ch); 
+  make_jmp(rgroup_locant, rgroup_locant, '&'); 
+
+  make_symbol_transitions(chain_open, rgroup_locant); 
+  for (unsigned char ch='0'; ch <= '9'; ch++) 
+    make_jmp(chain_open, rgroup_locant, ch); 
+  make_jmp(dash_open, rgroup_locant, '-'); 
+  
+  make_jmp(locant_space, ring_close, ' '); 
+  make_jmp(locant_space, rgroup_locant, ' '); 
+  make_jmp(locant_space, chain_open, ' '); 
+
+  /* ions */
+  if (dialect & WLN_DIALECT_IONS)
+    make_jmp(head, locant_space, '&'); 
+
+  /* inline ring defintions */
+  const unsigned int inline_ring_space  = state_init(); 
+  const unsigned int inline_ring_locant = state_init(); 
+  const unsigned int inline_spiro       = state_init(); 
+  
+  make_jmp(inline_ring_space, dash_open, ' '); 
+  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) 
+    make_jmp(inline_ring_locant, inline_ring_space, ch); 
+  make_jmp(inline_ring_locant, inline_ring_locant, '&'); 
+
+  make_jmp(ring_open, inline_ring_locant, 'L');  
+  make_jmp(ring_open, inline_ring_locant, 'T');  
+
+  /* inline spiro definition */
+  if (dialect & WLN_DIALECT_SPIRO)
+    make_jmp(inline_spiro, dash_open, '&');
+  make_jmp(inline_ring_space, inline_spiro, ' '); 
+
+}
+
+
+/* drops states the root cannot reach, keeping their order */
+static void prune_wlnfsm()
+{
+  unsigned short id[WLN_DFA_STATES]; 
+  unsigned short stack[WLN_DFA_STATES]; 
+  unsigned int nstack = 0; 
+  bool seen[WLN_DFA_STATES] = {false}; 
+
+  seen[0] = true; 
+  stack[nstack++] = 0; 
+  while (nstack) {
+    const unsigned short s = stack[--nstack]; 
+    for (unsigned int ch = 0; ch < 256; ch++) {
+      const unsigned short dst = wlnfsm[s].jmp[ch]; 
+      if (dst != 0xffff && !seen[dst]) {
+        seen[dst] = true; 
+        stack[nstack++] = dst; 
+      }
+    }
+  }
+
+  unsigned short n = 0; 
+  for (unsigned int s = 0; s < nstates; s++)
+    id[s] = seen[s] ? n++ : 0xffff; 
+
+  for (unsigned int s = 0; s < nstates; s++) {
+    if (!seen[s])
+      continue; 
+    for (unsigned int ch = 0; ch < 256; ch++) {
+      const unsigned short dst = wlnfsm[s].jmp[ch]; 
+      wlnfsm[s].jmp[ch] = dst == 0xffff ? dst : id[dst]; 
+    }
+    wlnfsm[id[s]] = wlnfsm[s]; 
+  }
+  nstates = n; 
+}
+
+
+/* 
+ * moore refinement, states stay together while they agree on acceptance 
+ * and on the block every byte leads to. Blocks are numbered by their first 
+ * state, so the root keeps id 0. 
+ */
+static void minimise_wlnfsm()
+{
+  unsigned short block[WLN_DFA_STATES]; 
+  unsigned short next[WLN_DFA_STATES]; 
+  unsigned short nblocks = 0; 
+
+  for (unsigned int s = 0; s < nstates; s++)
+    block[s] = wlnfsm[s].final; 
+
+  for (;;) {
+    unsigned short n = 0; 
+    for (unsigned int s = 0; s < nstates; s++) {
+      unsigned int t; 
+      for (t = 0; t < s; t++) {
+        if (block[t] != block[s])
+          continue; 
+        unsigned int ch = 0; 
+        for (; ch < 256; ch++) {
+          const unsigned short a = wlnfsm[s].jmp[ch]; 
+          const unsigned short b = wlnfsm[t].jmp[ch]; 
+          if (a == 0xffff || b == 0xffff ? a != b : block[a] != block[b])
+            break; 
+        }
+        if (ch == 256)
+          break; 
+      }
+      next[s] = t < s ? next[t] : n++; 
+    }
+
+    memcpy(block, next, sizeof(block)); 
+    if (n == nblocks)
+      break; 
+    nblocks = n; 
+  }
+
+  /* the first state of each block stands for it */
+  struct fsm_state *merged = (struct fsm_state*)malloc(nblocks*sizeof(struct fsm_state)); 
+  for (int s = nstates-1; s >= 0; s--) {
+    merged[block[s]].final = wlnfsm[s].final; 
+    for (unsigned int ch = 0; ch < 256; ch++) {
+      const unsigned short dst = wlnfsm[s].jmp[ch]; 
+      merged[block[s]].jmp[ch] = dst == 0xffff ? dst : block[dst]; 
+    }
+  }
+  memcpy(wlnfsm, merged, nblocks*sizeof(struct fsm_state)); 
+  nstates = nblocks; 
+  free(merged); 
+}
+
+
+/* one compressed automaton per dialect, rows at the widest possible stride */
+struct fsm_variant {
+  unsigned short nstates; 
+  unsigned short nclasses; 
+  unsigned char start_lo; 
+  unsigned char start_hi; 
+  unsigned char sync_class; 
+  unsigned char cls[256]; 
+  unsigned char jmp[WLN_DFA_STATES * WLN_DFA_CLASSES]; 
+  unsigned char final[WLN_DFA_STATES]; 
+}; 
+
+static struct fsm_variant variants[WLN_DIALECTS]; 
+
+
+/* bytes whose transitions agree in every state are folded into one class */
+static void compress_wlnfsm(struct fsm_variant *v)
+{
+  unsigned char class_byte[WLN_DFA_CLASSES]; 
+  unsigned short nclasses = 0; 
+
+  for (unsigned int ch = 0; ch < 256; ch++) {
+    unsigned int c; 
+    for (c = 0; c < nclasses; c++) {
+      unsigned int s = 0; 
+      while (s < nstates && wlnfsm[s].jmp[ch] == wlnfsm[s].jmp[class_byte[c]])
+        s++; 
+      if (s == nstates)
+        break; 
+    }
+
+    if (c == nclasses) {
+      if (nclasses == WLN_DFA_CLASSES) {
+        fprintf(stderr, "Error: wln automaton needs more than %d byte classes\n", WLN_DFA_CLASSES); 
+        exit(1); 
+      }
+      class_byte[nclasses++] = ch; 
+    }
+    v->cls[ch] = c; 
+  }
+
+  memset(v->jmp, NO_JMP, sizeof(v->jmp)); 
+  for (unsigned int s = 0; s < nstates; s++) {
+    v->final[s] = wlnfsm[s].final; 
+    for (unsigned int c = 0; c < nclasses; c++) {
+      unsigned short dst = wlnfsm[s].jmp[class_byte[c]]; 
+      v->jmp[s * WLN_DFA_CLASSES + c] = dst == 0xffff ? NO_JMP : dst; 
+    }
+  }
+
+  /* bytes with no transition anywhere all fold into one class */
+  v->sync_class = 0xff; 
+  for (unsigned int c = 0; c < nclasses; c++) {
+    unsigned int s = 0; 
+    while (s < nstates && v->jmp[s * WLN_DFA_CLASSES + c] == NO_JMP)
+      s++; 
+    if (s == nstates)
+      v->sync_class = c; 
+  }
+
+  /* every byte leaving the root lies in [start_lo, start_hi] */
+  v->start_lo = 0xff; 
+  v->start_hi = 0x00; 
+  for (unsigned int ch = 0; ch < 256; ch++) {
+    if (wlnfsm[0].jmp[ch] != 0xffff) {
+      v->start_lo = ch < v->start_lo ? ch : v->start_lo; 
+      v->start_hi = ch; 
+    }
+  }
+
+  v->nstates  = nstates; 
+  v->nclasses = nclasses; 
+}
+
+
+static void write_row(FILE *fp, const unsigned char *tab, unsigned int n, unsigned int pad)
+{
+  fprintf(fp, "\n   "); 
+  for (unsigned int i = 0; i < n; i++)
+    fprintf(fp, " %u,", tab[i]); 
+  for (unsigned int i = n; i < pad; i++)
+    fprintf(fp, " %u,", NO_JMP); 
+}
+
+
+/* 
+ * all variants share one layout, sized for the largest, so the scan 
+ * indexes any of them with the same constant stride. 
+ */
+static void write_header(FILE *fp)
+{
+  unsigned int max_states = 0; 
+  unsigned int max_classes = 0; 
+  for (unsigned int d = 0; d < WLN_DIALECTS; d++) {
+    max_states  = variants[d].nstates > max_states ? variants[d].nstates : max_states; 
+    max_classes = variants[d].nclasses > max_classes ? variants[d].nclasses : max_classes; 
+  }
+
+  unsigned int stride = 1; 
+  while (stride < max_classes)
+    stride *= 2; 
+
+  fprintf(fp, "/* generated by wlndfagen, do not edit */\n\n"); 
+  fprintf(fp, "#ifndef WLN_FSM_TABLES_H\n#define WLN_FSM_TABLES_H\n\n"); 
+  fprintf(fp, "#define WLN_DIALECT_C           0x%x\n", WLN_DIALECT_C); 
+  fprintf(fp, "#define WLN_DIALECT_IONS        0x%x\n", WLN_DIALECT_IONS); 
+  fprintf(fp, "#define WLN_DIALECT_SPIRO       0x%x\n", WLN_DIALECT_SPIRO); 
+  fprintf(fp, "#define WLN_DIALECT_MULTICYCLIC 0x%x\n", WLN_DIALECT_MULTICYCLIC); 
+  fprintf(fp, "#define WLN_DIALECTS            %u\n", WLN_DIALECTS); 
+  fprintf(fp, "#define WLN_DIALECT_DEFAULT     0x%x\n\n", WLN_DIALECT_DEFAULT); 
+  if (max_states >= WLN_LANE_STATE) {
+    fprintf(stderr, "Error: wln automaton has too many states for the lane table\n"); 
+    exit(1); 
+  }
+
+  fprintf(fp, "#define WLN_DFA_NSTATES  %u\n", max_states); 
+  fprintf(fp, "#define WLN_DFA_STRIDE   %u\n", stride); 
+  fprintf(fp, "#define WLN_DFA_IDLE     WLN_DFA_NSTATES\n\n"); 
+  fprintf(fp, "#define WLN_LANE_FAIL    0x%x\n", WLN_LANE_FAIL); 
+  fprintf(fp, "#define WLN_LANE_START   0x%x\n", WLN_LANE_START); 
+  fprintf(fp, "#define WLN_LANE_ACCEPT  0x%x\n", WLN_LANE_ACCEPT); 
+  fprintf(fp, "#define WLN_LANE_STATE   0x%x\n\n", WLN_LANE_STATE); 
+  fprintf(fp, "#endif\n\n"); 
+
+  /* the tables themselves are only wanted in the one unit that owns them */
+  fprintf(fp, "#if defined(WLN_DFA_TABLES) && !defined(WLN_FSM_TABLES_DATA)\n"); 
+  fprintf(fp, "#define WLN_FSM_TABLES_DATA\n\n"); 
+  fprintf(fp, "static const struct wln_dfa wlnfsm_dialects[WLN_DIALECTS] = {"); 
+  for (unsigned int d = 0; d < WLN_DIALECTS; d++) {
+    const struct fsm_variant *v = &variants[d]; 
+    fprintf(fp, "\n  /* dialect 0x%x, %u states, %u byte classes */\n  {", d, v->nstates, v->nclasses); 
+    fprintf(fp, "\n    %u, %u, 0x%02x, 0x%02x, %u,", v->nstates, v->nclasses, 
+            v->start_lo, v->start_hi, v->sync_class); 
+    fprintf(fp, "\n    {"); 
+    for (unsigned int r = 0; r < 256; r += 32)
+      write_row(fp, v->cls + r, 32, 32); 
+    fprintf(fp, "\n    },\n    {"); 
+    for (unsigned int s = 0; s < max_states; s++) {
+      if (s < v->nstates)
+        write_row(fp, v->jmp + s * WLN_DFA_CLASSES, v->nclasses, stride); 
+      else
+        write_row(fp, v->jmp, 0, stride); 
+    }
+    fprintf(fp, "\n    },\n    {"); 
+    write_row(fp, v->final, v->nstates, 0); 
+    fprintf(fp, "\n    },\n    {"); 
+
+    const unsigned int idle = max_states; 
+    unsigned char lane[WLN_DFA_CLASSES]; 
+    for (unsigned int s = 0; s <= max_states; s++) {
+      const bool real = s < v->nstates; 
+      for (unsigned int c = 0; c < v->nclasses; c++) {
+        const unsigned char dst  = real ? v->jmp[s * WLN_DFA_CLASSES + c] : NO_JMP; 
+        const unsigned char root = v->jmp[c]; 
+        const unsigned char fail = real ? WLN_LANE_FAIL : 0; 
+        if (dst != NO_JMP)
+          lane[c] = dst | (v->final[dst] ? WLN_LANE_ACCEPT : 0); 
+        else if (root != NO_JMP)
+          lane[c] = root | WLN_LANE_START | fail; 
+        else
+          lane[c] = idle | fail; 
+      }
+      write_row(fp, lane, v->nclasses, stride); 
+    }
+    fprintf(fp, "\n    },\n  },"); 
+  }
+  fprintf(fp, "\n};\n\n#endif\n"); 
+}
+
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2) {
+    fprintf(stderr, "usage: wlndfagen <header>\n"); 
+    return 1; 
+  }
+
+  for (dialect = 0; dialect < WLN_DIALECTS; dialect++) {
+    build_wlnfsm(); 
+    prune_wlnfsm(); 
+    minimise_wlnfsm(); 
+    compress_wlnfsm(&variants[dialect]); 
+  }
+
+  FILE *fp = fopen(argv[1], "w"); 
+  if (!fp) {
+    fprintf(stderr, "Error: could not open %s for writing\n", argv[1]); 
+    return 1; 
+  }
+  write_header(fp); 
+  fclose(fp); 
+
+  const struct fsm_variant *v = &variants[WLN_DIALECT_DEFAULT]; 
+  fprintf(stderr, "%s: %u dialects, default %u states, %u byte classes\n", 
+          argv[1], WLN_DIALECTS, v->nstates, v->nclasses); 
+  return 0; 
+}
@@ -0,0 +1,92 @@
+#ifndef WLN_ELEMENTS_H
+#define WLN_ELEMENTS_H
+
+#include <stdint.h>
+
+/* 
+ * element symbols shared by the reader and writer. Tokens are indexed by 
+ * atomic number and preformatted so the writer copies them whole, the 
+ * code table is generated from the same tokens at compile time so the two 
+ * directions cannot drift apart. Empty tokens are symbols the writer always 
+ * spells without dashes.
+ */
+
+#define WLN_ELEMENTS 119
+
+static constexpr char wln_element_token[WLN_ELEMENTS][5] = {
+  /*   0 */ "",     "",     "-HE-", "-LI-", "-BE-", "-B-",  "",     "-N-",
+  /*   8 */ "-O-",  "-F-",  "-NE-", "-NA-", "-MG-", "-AL-", "-SI-", "-P-",
+  /*  16 */ "",     "-G-",  "-AR-", "-KA-", "-CA-", "-SC-", "-TI-", "-VA-",
+  /*  24 */ "-CR-", "-MN-", "-FE-", "-CO-", "-NI-", "-CU-", "-ZN-", "-GA-",
+  /*  32 */ "-GE-", "-AS-", "-SE-", "-E-",  "-KR-", "-RB-", "-SR-", "-YT-",
+  /*  40 */ "-ZR-", "-NB-", "-MO-", "-TC-", "-RU-", "-RH-", "-PD-", "-AG-",
+  /*  48 */ "-CD-", "-IN-", "-SN-", "-SB-", "-TE-", "-I-",  "-XE-", "-CS-",
+  /*  56 */ "-BA-", "-LA-", "-CE-", "-PR-", "-ND-", "-PM-", "-SM-", "-EU-",
+  /*  64 */ "-GD-", "-TB-", "-DY-", "-HO-", "-ER-", "-TM-", "-YB-", "-LU-",
+  /*  72 */ "-HF-", "-TA-", "-WT-", "-RE-", "-OS-", "-IR-", "-PT-", "-AU-",
+  /*  80 */ "-HG-", "-TL-", "-PB-", "-BI-", "-PO-", "-AT-", "-RN-", "-FR-",
+  /*  88 */ "-RA-", "-AC-", "-TH-", "-PA-", "-UR-", "-NP-", "-PU-", "-AM-",
+  /*  96 */ "-CM-", "-BK-", "-CF-", "-ES-", "-FM-", "-MD-", "-NO-", "-LR-",
+  /* 104 */ "-RF-", "-DB-", "-SG-", "-BH-", "-HS-", "-MT-", "-DS-", "-RG-",
+  /* 112 */ "-CN-", "-NH-", "-FL-", "-MC-", "-LV-", "-TS-", "-OG-"
+};
+
+
+/* single letter codes inside dashes, K and M are read as plain nitrogen */
+static constexpr uint8_t wln_element_letter[26] = {
+   0,  5,  6,  0, 35,  9, 17,  0, 53,  0,  7,  0,  7,  /* A - M */
+   7,  8, 15,  8,  0, 16,  0,  0,  0,  0,  0,  0,  0   /* N - Z */
+};
+
+
+constexpr uint8_t wln_element_search(unsigned char fst, unsigned char snd, 
+                                     unsigned int z)
+{
+  return z == WLN_ELEMENTS ? 0 : 
+         (wln_element_token[z][1] == fst && wln_element_token[z][2] == snd) ? z :
+         wln_element_search(fst, snd, z+1); 
+}
+
+
+/* BR is still read as bromine, written as E */
+constexpr uint8_t wln_element_code(unsigned char fst, unsigned char snd)
+{
+  return (fst == 'B' && snd == 'R') ? 35 : wln_element_search(fst, snd, 1); 
+}
+
+
+struct wln_code_row   { uint8_t z[26]; }; 
+struct wln_code_table { struct wln_code_row row[26]; }; 
+
+template <unsigned int... I> struct wln_alphabet {}; 
+typedef wln_alphabet<0,1,2,3,4,5,6,7,8,9,10,11,12,
+                     13,14,15,16,17,18,19,20,21,22,23,24,25> wln_letters; 
+
+template <unsigned int... J>
+constexpr wln_code_row wln_code_row_make(unsigned char fst, wln_alphabet<J...>)
+{
+  return {{ wln_element_code(fst, 'A' + J)... }}; 
+}
+
+template <unsigned int... I>
+constexpr wln_code_table wln_code_table_make(wln_alphabet<I...> letters)
+{
+  return {{ wln_code_row_make('A' + I, letters)... }}; 
+}
+
+static constexpr wln_code_table wln_element_codes = wln_code_table_make(wln_letters()); 
+
+
+/* atomic number of a dash enclosed code, snd is 0 for one letter, 0 if none */
+static inline uint16_t wln_element_number(unsigned char fst, unsigned char snd)
+{
+  if (fst < 'A' || fst > 'Z')
+    return 0; 
+  if (!snd)
+    return wln_element_letter[fst - 'A']; 
+  if (snd < 'A' || snd > 'Z')
+    return 0; 
+  return wln_element_codes.row[fst - 'A'].z[snd - 'A']; 
+}
+
+#endif
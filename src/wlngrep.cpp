@@ -2,386 +2,1318 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include <openbabel/mol.h>
+#include <openbabel/obconversion.h>
+
+#include "wlnparser.h"
+#include "wlndfa.h"
+#include "wlnoutput.h"
+#include "wlntop.h"
 
 #define RESET  "\e[0;0m"
 #define RED    "\e[0;31m"
 
 // 0 - return whole line, 
 // 1 - return matches only, 
-// 2 - exact match only, 
+// 3 - count matches only, 
+// 4 - json record per match, 
+// 5 - most frequent matches, counted in a summary, 
+// -x restricts any of these to lines that are exact matches, 
+// --ocr reports corrected matches with their edit counts
 
 #define LINE_MATCH  0
 #define MATCH_ONLY  1
 #define COUNT_ONLY  3
-
-#define NO_JMP 0xffff
+#define JSON_MATCH  4
+#define TOP_MATCH   5
 
 int opt_match_option;  
+unsigned int opt_threads; 
+bool opt_recursive; 
+bool opt_line_number; 
+bool opt_byte_offset; 
+bool opt_track_lines; 
+bool opt_exact; 
+unsigned int opt_ocr;  // edit budget of the error tolerant scan, 0 for off
+unsigned int opt_top;  // matches listed by --top
+unsigned int opt_dialect; 
+bool opt_validate;  // matches must parse, set by --validate and --convert
+bool opt_convert; 
+const char *format; 
 unsigned char latty;
 unsigned long nmatches; 
+struct wln_top top;  // every worker's summary ends up here
 
 FILE *ifp; 
+const char *ifname; 
+
+/* command line inputs, and the files they expand to for the worker pool */
+const char **args; 
+unsigned int nargs; 
+
+char **files; 
+unsigned int nfiles; 
+unsigned int files_alloc; 
+
+#define WLN_BUF_SIZE 4096
+
+/* per thread per round in parallel mode, bounds the buffered output */
+#define WLN_CHUNK_SIZE (1 << 24)
+
+/* 
+ * with --validate matches are held back as candidates and go to the reader 
+ * in batches, a batch is written out in scan order once every candidate in 
+ * it is decided. A single stream validates on a pool of -j threads, the 
+ * parallel and multi file scans already run a thread per chunk or file so 
+ * each of those validates its own batches inline.
+ */
+#define WLN_QUEUE_SIZE 4096
+
+/* summary slots for --top k, counts are off by at most matches/slots */
+#define WLN_TOP_MAX 65536
+#define WLN_TOP_SLOTS(k) ((k) < 1024 ? 65536 : 64*(k))
+
+struct wlnqueue {
+  unsigned int n; 
+  unsigned int nthreads; 
+  char *arena; 
+  size_t len; 
+  size_t alloc; 
+  size_t offsets[WLN_QUEUE_SIZE+1]; 
+  size_t match_offset[WLN_QUEUE_SIZE]; 
+  size_t match_line[WLN_QUEUE_SIZE]; 
+  unsigned int match_edits[WLN_QUEUE_SIZE]; 
+  bool valid[WLN_QUEUE_SIZE]; 
+
+  /* --convert only, the valid candidates packed again for the full read */
+  char *packed; 
+  size_t packed_offsets[WLN_QUEUE_SIZE+1]; 
+  unsigned int packed_index[WLN_QUEUE_SIZE]; 
+  char *converted[WLN_QUEUE_SIZE]; 
+};
+
+/* 
+ * interleaved scan. The serial loop is one chain of dependent table loads 
+ * with a branch on every accept, which dense input mispredicts constantly. 
+ * A dense window is cut after sync bytes, where the automaton is always 
+ * back at the root, into lanes stepped together without branches over the 
+ * total lane table. Every failed candidate leaves a span, those holding a 
+ * match are then written in order exactly as the serial scan would have. 
+ * Sparse windows stay serial, the prefilter is far faster there. 
+ */
+#define WLN_LANES 2  // more spill the lane state out of registers
+#define WLN_LANE_WINDOW (1 << 15)
+#define WLN_LANE_DENSE (WLN_LANE_WINDOW / 16)  // candidates per window where lanes win
+
+struct wlnspan {
+  unsigned int start;       // from the window start
+  unsigned short last;      // last accept from start, 0 for none
+  unsigned short consumed; 
+}; 
+
+/* 
+ * scan state carried across blocks. Each parallel chunk gets its own, 
+ * with output kept in a memory buffer that is merged in order. 
+ */
+struct wlnscan {
+  struct wln_output *out; 
+  struct wlnqueue *queue; // NULL unless validating
+  struct wln_top *top;    // NULL unless --top
+  const char *path; 
+  bool matching; // the root is also reached inside ions
+  bool line_cr;  // -x only, the live line has met a CR that must end it
+  unsigned short curr_id; 
+  unsigned int wlnlen; 
+  unsigned int match_end; 
+  unsigned long nmatches; 
+  unsigned int nstarts;  // candidates in the current window, picks the engine
+
+  /* newlines never sit inside a match, so only skipped spans are counted */
+  size_t base;   // offset of the current block
+  size_t lines;  // newlines seen so far
+  size_t match_offset; 
+  size_t match_line; 
+  unsigned int match_edits; 
+  /* --ocr only, the exact automaton run alongside each candidate */
+  unsigned int exact_end;   // candidate bytes it took
+  unsigned int exact_match; // last byte of its match, zero if none
+  size_t fuzzy_cover;       // end of the last corrected match
+  char wln_buf[WLN_BUF_SIZE]; 
+
+  /* --ocr only, the sets of states after each byte of the candidate */
+  unsigned int fuzzy[WLN_BUF_SIZE][WLN_FUZZY_MAX+1]; 
+
+  /* dense windows only, a candidate spends at least a byte, plus the store past each lane */
+  struct wlnspan spans[WLN_LANE_WINDOW + WLN_LANES]; 
+};
+
+
+static void scan_init(struct wlnscan *sc, struct wln_output *out, const char *path)
+{
+  sc->out       = out; 
+  sc->queue     = (struct wlnqueue*)0; 
+  sc->top       = (struct wln_top*)0; 
+  sc->path      = path; 
+  sc->base      = 0; 
+  sc->lines     = 0; 
+  sc->matching  = opt_exact; // anchored scans begin at a line start
+  sc->line_cr   = false; 
+  sc->curr_id   = 0; 
+  sc->wlnlen    = 0; 
+  sc->match_end = 0; 
+  sc->match_edits = 0; 
+  sc->exact_end = 0; 
+  sc->exact_match = 0; 
+  sc->fuzzy_cover = 0; 
+  sc->nmatches  = 0; 
+  sc->nstarts   = 0; 
+}
 
-struct fsm_state {
-  bool final; 
-  unsigned short jmp[256]; 
-};  
-
-unsigned short nstates;
-struct fsm_state wlnfsm[64]; 
-
-static unsigned short state_init()
-{
-  wlnfsm[nstates].final = false; 
-  memset(wlnfsm[nstates].jmp, 0xff, sizeof(unsigned short)*256); 
-  return nstates++; 
-}
-
-#define is_accept(x) wlnfsm[x].final
-#define make_accept(x) wlnfsm[x].final = true
-#define make_jmp(dst,src,ch) wlnfsm[src].jmp[ch] = dst
-#define state_jmp(x,ch) wlnfsm[x].jmp[ch]
-
-
-static void make_symbol_transitions(unsigned int dst_id, unsigned int src_id)
-{
-	make_jmp(dst_id, src_id, 'B');
-
-#ifdef WLN_C_MATCH
-  // The C symbol in WLN is rare, and adding C as a potential 
-  // match token directly conflicts with SMILES. e.g most normal 
-  // organic SMILES will match due to C chains. Omitting this token
-  // here as default, can be recompiled to match C symbols.
-	
-  make_jmp(dst_id, src_id, 'C');
-#endif
-	
-  make_jmp(dst_id, src_id, 'E');
-	make_jmp(dst_id, src_id, 'F');
-	make_jmp(dst_id, src_id, 'G');
-	make_jmp(dst_id, src_id, 'H');
-	make_jmp(dst_id, src_id, 'I');
-	make_jmp(dst_id, src_id, 'K');
-	make_jmp(dst_id, src_id, 'M');
-	make_jmp(dst_id, src_id, 'N');
-	make_jmp(dst_id, src_id, 'O');
-	make_jmp(dst_id, src_id, 'P');
-	make_jmp(dst_id, src_id, 'Q');
-	make_jmp(dst_id, src_id, 'R');
-	make_jmp(dst_id, src_id, 'S');
-	make_jmp(dst_id, src_id, 'U');
-	make_jmp(dst_id, src_id, 'V');
-	make_jmp(dst_id, src_id, 'W');
-	make_jmp(dst_id, src_id, 'X');
-	make_jmp(dst_id, src_id, 'Y');
-	make_jmp(dst_id, src_id, 'Z');
-}
-
-
-static void init_wlnfsm() 
-{
-  nstates = 0; 
-  const unsigned int head        = state_init(); 
-
-  const unsigned int chain_open  = state_init(); 
-  const unsigned int locant_space = state_init(); 
-  
-  make_accept(chain_open); 
-  make_symbol_transitions(chain_open, head); 
-  make_symbol_transitions(chain_open, chain_open); 
 
-  for (unsigned char ch='0'; ch <= '9'; ch++) {
-    make_jmp(chain_open, head, ch); 
-    make_jmp(chain_open, chain_open, ch); 
+static size_t count_lines(const char *buf, size_t n)
+{
+  size_t lines = 0; 
+  for (size_t i = 0; i < n; i++)
+    lines += buf[i] == '\n'; 
+  return lines; 
+}
+
+
+static void write_number(struct wln_output *out, size_t n)
+{
+  char digits[24]; 
+  unsigned int pos = 24; 
+  do {
+    digits[--pos] = (n % 10) + '0'; 
+    n /= 10; 
+  } while (n); 
+  wln_output_write(out, digits+pos, 24-pos); 
+}
+
+
+/* runs of plain bytes go out whole, only quotes and controls are escaped */
+static void write_json_string(struct wln_output *out, const char *str, size_t n)
+{
+  size_t run = 0; 
+  wln_output_write(out, "\"", 1); 
+  for (size_t i = 0; i < n; i++) {
+    unsigned char ch = str[i]; 
+    if (ch != '"' && ch != '\\' && ch >= 0x20)
+      continue; 
+
+    wln_output_write(out, str+run, i-run); 
+    run = i+1; 
+    if (ch < 0x20) {
+      char esc[8]; 
+      wln_output_write(out, esc, snprintf(esc, 8, "\\u%04x", ch)); 
+    }
+    else {
+      wln_output_write(out, "\\", 1); 
+      wln_output_write(out, str+i, 1); 
+    }
   }
+  wln_output_write(out, str+run, n-run); 
+  wln_output_write(out, "\"", 1); 
+}
 
-  make_jmp(chain_open, chain_open, '&'); 
-  
-  const unsigned int dash_open  = state_init();
-  const unsigned int dash_elem  = state_init();
-  const unsigned int dash_close = state_init();
 
-  /* generic elemental characters */
-  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) {
-    make_jmp(dash_elem, dash_open, ch); 
-    make_jmp(dash_close, dash_elem, ch); 
+/* one match record, converted is the --convert output or NULL */
+static void write_match(struct wlnscan *sc, const char *str, size_t n, size_t offset, 
+                        size_t line, unsigned int edits, const char *converted)
+{
+  switch (opt_match_option)  {
+    case MATCH_ONLY: 
+      if (opt_line_number) {
+        write_number(sc->out, line); 
+        wln_output_write(sc->out, ":", 1); 
+      }
+      if (opt_byte_offset) {
+        write_number(sc->out, offset); 
+        wln_output_write(sc->out, ":", 1); 
+      }
+      wln_output_write(sc->out, str, n); 
+      if (opt_ocr) {
+        wln_output_write(sc->out, "\t", 1); 
+        write_number(sc->out, edits); 
+      }
+      if (converted) {
+        wln_output_write(sc->out, "\t", 1); 
+        wln_output_write(sc->out, converted, strlen(converted)); 
+      }
+      wln_output_write(sc->out, "\n", 1); 
+      break; 
+
+    case JSON_MATCH: 
+      wln_output_write(sc->out, "{\"file\":", 8); 
+      write_json_string(sc->out, sc->path, strlen(sc->path)); 
+      wln_output_write(sc->out, ",\"offset\":", 10); 
+      write_number(sc->out, offset); 
+      wln_output_write(sc->out, ",\"line\":", 8); 
+      write_number(sc->out, line); 
+      wln_output_write(sc->out, ",\"match\":", 9); 
+      write_json_string(sc->out, str, n); 
+      if (opt_ocr) {
+        wln_output_write(sc->out, ",\"edits\":", 9); 
+        write_number(sc->out, edits); 
+      }
+      if (converted) {
+        wln_output_write(sc->out, ",", 1); 
+        write_json_string(sc->out, format, strlen(format)); 
+        wln_output_write(sc->out, ":", 1); 
+        write_json_string(sc->out, converted, strlen(converted)); 
+      }
+      wln_output_write(sc->out, "}\n", 2); 
+      break; 
+
+    case COUNT_ONLY: sc->nmatches++; break; 
+    case TOP_MATCH: wln_top_add(sc->top, str, n); break; 
   }
-  
-  make_jmp(dash_open, head, '-'); 
-  make_jmp(dash_open, chain_open, '-'); 
-  make_jmp(chain_open, dash_close, '-'); 
+}
+
+
+static struct wlnqueue* queue_new(unsigned int nthreads)
+{
+  struct wlnqueue *q = (struct wlnqueue*)malloc(sizeof(struct wlnqueue)); 
+  q->n        = 0; 
+  q->nthreads = nthreads; 
+  q->len      = 0; 
+  q->alloc    = 1 << 16; 
+  q->arena    = (char*)malloc(q->alloc); 
+  q->packed   = opt_convert ? (char*)malloc(q->alloc) : (char*)0; 
+  q->offsets[0] = 0; 
+  return q; 
+}
 
-  /* cyclic internal block states */
 
-  const unsigned int ring_open   = state_init(); 
-  const unsigned int ring_close  = state_init(); 
-  const unsigned int ring_digits = state_init(); 
+static void queue_free(struct wlnqueue *q)
+{
+  if (!q)
+    return; 
+  free(q->arena); 
+  free(q->packed); 
+  free(q); 
+}
 
-  make_accept(ring_close); 
 
-  make_jmp(ring_open, head, 'L');  
-  make_jmp(ring_open, head, 'T');  
+/* runs on the reader's batch threads, each keeps its own conversion */
+static void convert_record(unsigned int record, bool ok, OpenBabel::OBMol *mol, void *data)
+{
+  static thread_local OpenBabel::OBConversion conv; 
+  static thread_local bool conv_ready = false; 
+  if (!conv_ready) {
+    conv.SetOutFormat(format); 
+    conv.AddOption("h",OpenBabel::OBConversion::OUTOPTIONS); 
+    conv_ready = true; 
+  }
 
-  for (unsigned char ch = '0'; ch <= '9'; ch++) {
-    make_jmp(ring_digits, ring_open, ch);
-    make_jmp(ring_digits, ring_digits, ch);
+  struct wlnqueue *q = (struct wlnqueue*)data; 
+  const unsigned int i = q->packed_index[record]; 
+  if (!ok) {
+    q->valid[i] = false; 
+    return; 
   }
 
-  make_jmp(ring_close, ring_digits, 'J'); 
+  /* toolkit writers end records with a title field and newline */
+  std::string str = conv.WriteString(mol); 
+  size_t n = str.size(); 
+  while (n && (str[n-1] == '\n' || str[n-1] == '\t' || str[n-1] == ' ' || str[n-1] == '\r'))
+    n--; 
+  if (!n) {
+    q->valid[i] = false; 
+    return; 
+  }
+  q->converted[i] = strndup(str.c_str(), n); 
+}
 
-  const unsigned int digit_space  = state_init(); 
-  const unsigned int digit_locant = state_init(); 
-  
-  /* ring digit locants and bridge atoms */
-  make_jmp(digit_space, ring_open, ' '); 
-  make_jmp(digit_space, ring_digits, ' '); 
-  
-  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) 
-    make_jmp(digit_locant, digit_space, ch); 
-  make_jmp(digit_locant, digit_locant, '&'); 
 
-  make_jmp(digit_space, digit_locant, ' '); 
+/* 
+ * validation always comes first, the full read only sees strings that 
+ * passed it, so nothing the grammar rejects ever builds a molecule.
+ */
+static void queue_flush(struct wlnscan *sc)
+{
+  struct wlnqueue *q = sc->queue; 
+  if (!q->n)
+    return; 
+
+  ValidateWLNBatch(q->arena, q->offsets, q->n, q->valid, q->nthreads); 
+
+  if (opt_convert) {
+    unsigned int npacked = 0; 
+    size_t len = 0; 
+    q->packed_offsets[0] = 0; 
+    for (unsigned int i = 0; i < q->n; i++) {
+      q->converted[i] = (char*)0; 
+      if (!q->valid[i])
+        continue; 
+      const size_t n = q->offsets[i+1] - q->offsets[i]; 
+      memcpy(q->packed + len, q->arena + q->offsets[i], n); 
+      len += n; 
+      q->packed_index[npacked++] = i; 
+      q->packed_offsets[npacked] = len; 
+    }
+    ReadWLNBatch(q->packed, q->packed_offsets, npacked, convert_record, q, 
+                 q->nthreads, (struct wln_batch_summary*)0); 
+  }
 
-  for (unsigned char ch = '0'; ch <= '9'; ch++) 
-    make_jmp(ring_digits,digit_locant, ch); 
-  
-  make_jmp(ring_close, digit_locant, 'J'); 
+  for (unsigned int i = 0; i < q->n; i++) {
+    if (q->valid[i]) {
+      write_match(sc, q->arena + q->offsets[i], q->offsets[i+1] - q->offsets[i], 
+                  q->match_offset[i], q->match_line[i], q->match_edits[i], 
+                  opt_convert ? q->converted[i] : (char*)0); 
+    }
+    if (opt_convert)
+      free(q->converted[i]); 
+  }
+
+  q->n   = 0; 
+  q->len = 0; 
+}
 
-  /* multicyclic ring block defintion */
-  // n, locants, space, size
 
-  const unsigned int multi_digit    = state_init(); 
-  const unsigned int multi_locants  = state_init(); 
-  const unsigned int multi_break    = state_init(); 
-  const unsigned int multi_size     = state_init(); 
-  for (unsigned char ch = '0'; ch <= '9'; ch++) {
-    make_jmp(multi_digit, digit_space, ch); 
-    make_jmp(multi_digit, multi_digit, ch); 
+static void queue_push(struct wlnscan *sc, const char *str, size_t n)
+{
+  struct wlnqueue *q = sc->queue; 
+  if (q->len + n > q->alloc) {
+    while (q->len + n > q->alloc)
+      q->alloc *= 2; 
+    q->arena = (char*)realloc(q->arena, q->alloc); 
+    if (q->packed)
+      q->packed = (char*)realloc(q->packed, q->alloc); 
   }
 
-  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) {
-    make_jmp(multi_locants, multi_digit, ch); 
-    make_jmp(multi_locants, multi_locants, ch); 
+  memcpy(q->arena + q->len, str, n); 
+  q->len += n; 
+  q->match_offset[q->n] = sc->match_offset; 
+  q->match_line[q->n]   = sc->match_line; 
+  q->match_edits[q->n]  = sc->match_edits; 
+  q->offsets[++q->n]    = q->len; 
+
+  if (q->n == WLN_QUEUE_SIZE)
+    queue_flush(sc); 
+}
+
+
+static void handle_match(struct wlnscan *sc, const char *buffer, int match_end, int consumed)
+{
+  if (sc->queue) {
+    queue_push(sc, buffer, match_end); 
+    return; 
   }
-  make_jmp(multi_locants, multi_locants, '&'); 
-  make_jmp(multi_break, multi_locants, ' '); 
 
-  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) 
-    make_jmp(multi_size, multi_break, ch); 
-  make_jmp(multi_size, multi_size, '&'); 
-  
-  make_jmp(ring_close, multi_size, 'J'); 
-
-  /* hetero element definitions */
-  const unsigned int ring_hetero        = state_init(); 
-  const unsigned int hetero_dash_open   = state_init(); 
-  const unsigned int hetero_dash_elem_a = state_init(); 
-  const unsigned int hetero_dash_elem_b = state_init(); 
-  const unsigned int hetero_dash_close  = state_init(); 
-  const unsigned int hetero_space       = state_init(); 
-  const unsigned int hetero_locant      = state_init(); 
-
-  make_symbol_transitions(ring_hetero, ring_digits); 
-  make_symbol_transitions(ring_hetero, digit_locant); 
-  make_symbol_transitions(ring_hetero, multi_size); 
-  make_symbol_transitions(ring_hetero, ring_hetero); 
-  make_symbol_transitions(ring_hetero, hetero_locant); 
-  make_symbol_transitions(ring_hetero, hetero_dash_close); 
-
-  make_jmp(hetero_dash_open, ring_digits, '-'); 
-  make_jmp(hetero_dash_open, digit_locant, '-'); 
-  make_jmp(hetero_dash_open, multi_size, '-'); 
-  make_jmp(hetero_dash_open, ring_hetero, '-'); 
-  make_jmp(hetero_dash_open, hetero_locant, '-'); 
-
-  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) {
-    make_jmp(hetero_dash_elem_a, hetero_dash_open, ch); 
-    make_jmp(hetero_dash_elem_b, hetero_dash_elem_a, ch); 
-  }
-  make_jmp(hetero_dash_close, hetero_dash_elem_b, '-'); 
-
-  make_jmp(hetero_space, multi_size, ' '); 
-  make_jmp(hetero_space, ring_hetero, ' '); 
-
-  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) 
-    make_jmp(hetero_locant, hetero_space, ch); 
-
-  make_jmp(ring_close, hetero_dash_close, 'J'); 
-  make_jmp(hetero_space, hetero_dash_close, ' '); 
-  make_jmp(ring_close, ring_hetero, 'J'); 
-
-  make_jmp(ring_close, ring_close, '&'); 
-  
-  /* aromaticity assignments */
-  const unsigned int aromacity  = state_init(); 
-  make_jmp(ring_close, aromacity, 'J'); 
-  make_jmp(aromacity, aromacity, 'T'); 
-  make_jmp(aromacity, aromacity, '&'); 
-  
-  make_jmp(aromacity, ring_digits, 'T'); 
-  make_jmp(aromacity, ring_digits, '&'); 
+  if (opt_match_option == LINE_MATCH) {
+    if (latty) wln_output_write(sc->out, RED, sizeof(RED)-1); 
+    wln_output_write(sc->out, buffer, match_end); 
+    if (latty) wln_output_write(sc->out, RESET, sizeof(RESET)-1); 
 
-  make_jmp(aromacity, digit_locant, 'T'); 
-  make_jmp(aromacity, digit_locant, '&'); 
+    if (consumed > match_end)
+      wln_output_write(sc->out, buffer+match_end, consumed-match_end); 
+  }
+  else
+    write_match(sc, buffer, match_end, sc->match_offset, sc->match_line, sc->match_edits, (char*)0); 
+}
 
-  make_jmp(aromacity, multi_size, 'T'); 
-  make_jmp(aromacity, multi_size, '-'); 
 
-  make_jmp(aromacity, ring_hetero, 'T'); 
-  make_jmp(aromacity, ring_hetero, '&'); 
+/* the next line begins at pos of the current block */
+static void line_start(struct wlnscan *sc, size_t pos)
+{
+  sc->matching  = true; 
+  sc->line_cr   = false; 
+  sc->curr_id   = 0; 
+  sc->wlnlen    = 0; 
+  sc->match_offset = sc->base + pos; 
+  sc->match_line   = sc->lines + 1; 
+}
 
-  make_jmp(aromacity, hetero_dash_close, 'T'); 
-  make_jmp(aromacity, hetero_dash_close, '&'); 
 
-  /* ring locant jump into specific blocks */ 
-  const unsigned int rgroup_locant = state_init(); 
+/* a whole line was accepted, single bytes are never reported as in the unanchored scan */
+static void handle_line(struct wlnscan *sc)
+{
+  if (sc->wlnlen < 2)
+    return; 
+  handle_match(sc, sc->wln_buf, sc->wlnlen, sc->wlnlen); 
+  if (opt_match_option == LINE_MATCH)
+    wln_output_write(sc->out, "\n", 1); 
+}
 
-  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) 
-    make_jmp(rgroup_locant, locant_space, ch); 
-  make_jmp(rgroup_locant, rgroup_locant, '&'); 
 
-  make_symbol_transitions(chain_open, rgroup_locant); 
-  for (unsigned char ch='0'; ch <= '9'; ch++) 
-    make_jmp(chain_open, rgroup_locant, ch); 
-  make_jmp(dash_open, rgroup_locant, '-'); 
-  
-  make_jmp(locant_space, ring_close, ' '); 
-  make_jmp(locant_space, rgroup_locant, ' '); 
-  make_jmp(locant_space, chain_open, ' '); 
+/* 
+ * anchored scan for -x. The automaton runs from each line start and gives 
+ * up at the first failed transition, the rest of the line is skipped with 
+ * memchr rather than restarted on every byte. Only lines accepted whole 
+ * are reported, matching means the current line is still live. A CR is 
+ * only taken as the end of a CRLF line, the line dies if anything else 
+ * follows it. 
+ */
+static void scan_block_exact(struct wlnscan *sc, const char *buffer, size_t bytes)
+{
+  const struct wln_dfa *fsm = wlnfsm; 
+  /* a line starting here, parallel chunks only know their line count now */
+  if (sc->matching && !sc->wlnlen)
+    line_start(sc, 0); 
+
+  size_t i = 0; 
+  while (i < bytes) {
+    if (!sc->matching) {
+      const char *nl = (const char*)memchr(buffer+i, '\n', bytes-i); 
+      if (!nl) 
+        break; 
+      i = nl - buffer + 1; 
+      sc->lines++; 
+      line_start(sc, i); 
+      continue; 
+    }
+
+    for (; i < bytes; i++) {
+      unsigned char ch = buffer[i]; 
+      if (ch == '\n') {
+        if (dfa_accept(fsm, sc->curr_id))
+          handle_line(sc); 
+        sc->lines++; 
+        line_start(sc, i+1); 
+        continue; 
+      }
+      if (ch == '\r' && !sc->line_cr) {
+        sc->line_cr = true; 
+        continue; 
+      }
 
-  /* ions */
-  make_jmp(head, locant_space, '&'); 
+      unsigned int jmp_id = dfa_jmp(fsm, sc->curr_id, ch); 
+      if (jmp_id == NO_JMP || sc->line_cr || sc->wlnlen >= WLN_BUF_SIZE) {
+        sc->matching = false; 
+        break; 
+      }
+      sc->curr_id = jmp_id; 
+      sc->wln_buf[sc->wlnlen++] = ch; 
+    }
+  }
+  sc->base += bytes; 
+}
 
-  /* inline ring defintions */
-  const unsigned int inline_ring_space  = state_init(); 
-  const unsigned int inline_ring_locant = state_init(); 
-  const unsigned int inline_spiro       = state_init(); 
-  
-  make_jmp(inline_ring_space, dash_open, ' '); 
-  for (unsigned char ch = 'A'; ch <= 'Z'; ch++) 
-    make_jmp(inline_ring_locant, inline_ring_space, ch); 
-  make_jmp(inline_ring_locant, inline_ring_locant, '&'); 
 
-  make_jmp(ring_open, inline_ring_locant, 'L');  
-  make_jmp(ring_open, inline_ring_locant, 'T');  
+/* 
+ * matches found by the --ocr scan go out corrected, whole lines and counts 
+ * only need where they are. 
+ */
+static void handle_fuzzy_match(struct wlnscan *sc, unsigned int consumed)
+{
+  if (opt_match_option == LINE_MATCH || opt_match_option == COUNT_ONLY) {
+    handle_match(sc, sc->wln_buf, sc->match_end+1, consumed); 
+    return; 
+  }
+
+  char fixed[2*WLN_BUF_SIZE]; 
+  const unsigned int n = wlnfsm_fuzzy_correct(sc->wln_buf, sc->match_end+1, sc->fuzzy, opt_ocr, fixed); 
+  handle_match(sc, fixed, n, n); 
+}
 
-  /* inline spiro definition */
-  make_jmp(inline_spiro, dash_open, '&');
-  make_jmp(inline_ring_space, inline_spiro, ' '); 
 
-  fprintf(stderr, "%u states\n", nstates); 
+/* 
+ * ends the live --ocr candidate and gives the offset the scan resumes at, 
+ * the byte the exact scan would fail on. Every match of the exact scan is 
+ * so found and taken over a corrected one from the same start, corrections 
+ * fill in where it finds nothing and never overlap one another. Whole 
+ * lines cannot overlap, they resume past the match. 
+ */
+static size_t fuzzy_end(struct wlnscan *sc)
+{
+  unsigned int restart = sc->wlnlen; 
+  if (sc->wlnlen < WLN_BUF_SIZE)
+    restart = sc->exact_end ? sc->exact_end : 1; 
+
+  if (sc->exact_match > 0) {
+    sc->match_end   = sc->exact_match; 
+    sc->match_edits = 0; 
+  }
+  else if (sc->match_offset < sc->fuzzy_cover)
+    sc->match_end = 0; 
+  else if (sc->match_end > 0)
+    sc->fuzzy_cover = sc->match_offset + sc->match_end + 1; 
+
+  if (sc->match_end > 0 && opt_match_option == LINE_MATCH && restart < sc->match_end+1)
+    restart = sc->match_end+1; 
+
+  if (sc->match_end > 0) 
+    handle_fuzzy_match(sc, restart); 
+  else if (opt_match_option == LINE_MATCH)
+    wln_output_write(sc->out, sc->wln_buf, restart); 
+  sc->match_end = 0; 
+  sc->matching  = false; 
+  return sc->match_offset + restart; 
 }
 
 
-static void handle_match(char *buffer, int match_end, int consumed)
+static void scan_block_fuzzy(struct wlnscan *sc, const char *buffer, size_t bytes); 
+
+/* 
+ * rescans the candidate bytes from restart up to the block base, they are 
+ * still held in wln_buf. Candidates found here start past restart, so 
+ * this never has to go back further itself. 
+ */
+static void fuzzy_replay(struct wlnscan *sc, size_t restart)
 {
-  switch (opt_match_option)  {
-    case LINE_MATCH:
-      if (latty) printf(RED); 
-      fwrite(buffer, match_end, 1, stdout); 
-      if (latty) printf(RESET); 
+  char replay[WLN_BUF_SIZE]; 
+  const size_t n = sc->base - restart; 
+  memcpy(replay, sc->wln_buf + (restart - sc->match_offset), n); 
+  sc->base = restart; 
+  scan_block_fuzzy(sc, replay, n); 
+}
 
-      if (consumed > match_end)
-        fwrite(buffer+match_end, consumed-match_end, 1, stdout); 
-      break; 
 
-    case MATCH_ONLY: 
-      fwrite(buffer, match_end, 1, stdout); 
-      fputc('\n', stdout); 
+/* 
+ * error tolerant scan for --ocr, the serial scan run over the sets of 
+ * states reachable within the edit budget. Candidates begin as there, a 
+ * match is the longest accepted prefix with the fewest edits at that 
+ * length, and the exact automaton is run alongside to find the restart. 
+ */
+static void scan_block_fuzzy(struct wlnscan *sc, const char *buffer, size_t bytes)
+{
+  const struct wln_dfa *fsm = wlnfsm; 
+  static const unsigned int root[WLN_FUZZY_MAX+1] = {1u}; 
+  size_t i = 0; 
+  size_t start; 
+
+  if (sc->matching)
+    goto jmp_matching; 
+
+jmp_not_matching:
+  sc->matching = false; 
+  /* only bytes leaving the root as read or swapped are tried */
+  for (start = i; start < bytes; start++) {
+    const unsigned char ch = buffer[start]; 
+    const unsigned char swap = wlnfsm_ocr_swap(ch); 
+    if ((state_jmp(0, ch) != NO_JMP || (swap && state_jmp(0, swap) != NO_JMP)) && 
+        wlnfsm_fuzzy_step(root, sc->fuzzy[0], opt_ocr, ch))
       break; 
+  }
+  if (opt_match_option == LINE_MATCH && start > i) 
+    wln_output_write(sc->out, buffer+i, start-i); 
+  if (opt_track_lines)
+    sc->lines += count_lines(buffer+i, start-i); 
+  if (start == bytes) {
+    sc->base += bytes; 
+    return; 
+  }
+
+  i = start; 
+  sc->matching  = true; 
+  sc->match_offset = sc->base + i; 
+  sc->match_line   = sc->lines + 1; 
+  sc->wlnlen    = 0; 
+  sc->match_end = 0; 
+  sc->curr_id   = dfa_jmp(fsm, 0, (unsigned char)buffer[i]); 
+  sc->exact_end = sc->curr_id != NO_JMP ? 1:0; 
+  sc->exact_match = 0; 
+  sc->wln_buf[sc->wlnlen++] = buffer[i]; 
+  i++; // skip to next char
+
+jmp_matching:
+  for (; i < bytes; i++) {
+    unsigned char ch = buffer[i]; 
+    if (sc->wlnlen >= WLN_BUF_SIZE || 
+        !wlnfsm_fuzzy_step(sc->fuzzy[sc->wlnlen-1], sc->fuzzy[sc->wlnlen], opt_ocr, ch)) {
+      if (sc->wlnlen >= WLN_BUF_SIZE)
+        fprintf(stderr, "Warning: WLN string too long!\n");
+      const size_t restart = fuzzy_end(sc); 
+      if (restart >= sc->base) {
+        i = restart - sc->base; 
+        goto jmp_not_matching;
+      }
+
+      /* the candidate began in an earlier block */
+      fuzzy_replay(sc, restart); 
+      i = 0; 
+      if (sc->matching)
+        goto jmp_matching; 
+      goto jmp_not_matching;
+    }
+
+    if (sc->exact_end == sc->wlnlen) {
+      const unsigned int jmp_id = dfa_jmp(fsm, sc->curr_id, ch); 
+      if (jmp_id != NO_JMP) {
+        sc->curr_id = jmp_id; 
+        if (dfa_accept(fsm, jmp_id))
+          sc->exact_match = sc->wlnlen; 
+        sc->exact_end++; 
+      }
+    }
 
-    case COUNT_ONLY: nmatches++; break; 
+    const int edits = wlnfsm_fuzzy_accept(sc->fuzzy[sc->wlnlen], opt_ocr); 
+    if (edits >= 0) {
+      sc->match_end   = sc->wlnlen; 
+      sc->match_edits = edits; 
+    }
+    sc->wln_buf[sc->wlnlen++] = ch; 
   }
+  sc->base += bytes; 
 }
 
 
-/* uses goto to keep logic clean, nothing to be scared of */
-static bool process_file(FILE *fp)
+/* 
+ * scans buffer[i, bytes) carrying state across calls, the block base is 
+ * left to the caller. Uses goto to keep logic clean, nothing to be scared of 
+ */
+static void scan_serial(struct wlnscan *sc, const char *buffer, size_t i, size_t bytes)
 {
-  const size_t bufsize = 16384; 
-  const size_t wlnbuf_size = 4096; 
-
-  char buffer[bufsize]; 
-  char wln_buf[wlnbuf_size]; 
-  unsigned int wlnlen = 0; 
-  
   const unsigned short root_id = 0; 
-  unsigned short curr_id = root_id; 
-  
+  const struct wln_dfa *fsm = wlnfsm; 
   unsigned int jmp_id; 
-  unsigned int match_end = 0; 
+  size_t start; 
 
-  nmatches = 0; 
-  
-  while (true) {
-jmp_fetch_data:
-    size_t bytes = fread(buffer, 1, bufsize, fp); 
-    if (!bytes) {
-      if (match_end > 0) 
-        handle_match(wln_buf, match_end+1, wlnlen);  
-      return true;
+  if (sc->matching)
+    goto jmp_matching; 
+
+jmp_not_matching:
+  sc->matching = false; 
+  /* bytes that cannot leave the root are skipped in bulk */
+  start = wlnfsm_next_start(buffer, i, bytes); 
+  if (opt_match_option == LINE_MATCH && start > i) 
+    wln_output_write(sc->out, buffer+i, start-i); 
+  if (opt_track_lines)
+    sc->lines += count_lines(buffer+i, start-i); 
+  if (start == bytes) 
+    return; 
+
+  i = start; 
+  sc->nstarts++; 
+  sc->matching  = true; 
+  sc->match_offset = sc->base + i; 
+  sc->match_line   = sc->lines + 1; 
+  sc->wlnlen    = 0; 
+  sc->match_end = 0; 
+  sc->curr_id = dfa_jmp(fsm, root_id, (unsigned char)buffer[i]); 
+  sc->wln_buf[sc->wlnlen++] = buffer[i]; 
+  i++; // skip to next char
+
+jmp_matching:
+  for (; i < bytes; i++) { 
+    unsigned char ch = buffer[i]; 
+    jmp_id = dfa_jmp(fsm, sc->curr_id, ch);  
+    if (jmp_id == NO_JMP || sc->wlnlen >= WLN_BUF_SIZE) {
+      if (jmp_id != NO_JMP)
+        fprintf(stderr, "Warning: WLN string too long!\n");
+      sc->curr_id = root_id; 
+      if (sc->match_end > 0) 
+        handle_match(sc, sc->wln_buf, sc->match_end+1, sc->wlnlen);  
+      else if (opt_match_option == LINE_MATCH)
+        wln_output_write(sc->out, sc->wln_buf, sc->wlnlen); 
+      sc->match_end = 0; 
+      goto jmp_not_matching;
+    }
+    else {
+      sc->curr_id = jmp_id; 
+      sc->wln_buf[sc->wlnlen] = ch; 
+      sc->match_end = dfa_accept(fsm, sc->curr_id) ? sc->wlnlen : sc->match_end; 
+      sc->wlnlen++; 
     }
+  }
+}
+
+
+/* one past the first sync byte in [i, n), or n */
+static size_t next_sync(const struct wln_dfa *fsm, const char *buffer, size_t i, size_t n)
+{
+  while (i < n && !dfa_sync(fsm, (unsigned char)buffer[i]))
+    i++; 
+  return i < n ? i+1 : n; 
+}
 
-    unsigned int i = 0; 
 
-    if (curr_id)
-      goto jmp_matching; 
+/* 
+ * buffer[start, stop) must begin at the root and end after a sync byte. 
+ * Returns false without writing anything if a candidate reached the serial 
+ * length limit, the caller then scans the window serially. 
+ */
+static bool scan_lanes(struct wlnscan *sc, const char *buffer, size_t start, size_t stop)
+{
+  const struct wln_dfa *fsm = wlnfsm; 
+  const char *win = buffer + start; 
+  const unsigned int n = stop - start; 
+
+  struct wlnspan *span_start[WLN_LANES]; 
+  struct wlnspan *span[WLN_LANES]; 
+  unsigned int pos[WLN_LANES]; 
+  unsigned int end[WLN_LANES]; 
+  unsigned int mstart[WLN_LANES]; 
+  unsigned int mlast[WLN_LANES];   // last accept of the candidate
+  unsigned int cur[WLN_LANES]; 
+
+  unsigned int p = 0; 
+  unsigned int steps = n; 
+  for (unsigned int k = 0; k < WLN_LANES; k++) {
+    const unsigned int e = k == WLN_LANES-1 ? n : next_sync(fsm, win, p + n/WLN_LANES < n ? p + n/WLN_LANES : n, n); 
+    span_start[k] = k ? span_start[k-1] + (end[k-1] - pos[k-1]) + 1 : sc->spans; 
+    span[k]   = span_start[k]; 
+    pos[k]    = p; 
+    end[k]    = e; 
+    mstart[k] = p; 
+    mlast[k]  = p; 
+    cur[k]    = WLN_DFA_IDLE; 
+    steps = e - p < steps ? e - p : steps; 
+    p = e; 
+  }
 
-jmp_not_matching:
-    for (; i < bytes; i++) {
-      unsigned char ch = buffer[i]; 
-      jmp_id = state_jmp(curr_id, ch);  
-      if (jmp_id != NO_JMP) {
-        wlnlen    = 0; 
-        match_end = 0; 
-        curr_id = jmp_id; 
-        wln_buf[wlnlen++] = ch; 
-        i++; // skip to next char
-        goto jmp_matching;
-      }
-      else if (opt_match_option == LINE_MATCH) 
-        fputc(ch, stdout);
+/* 
+ * one byte of lane k, the span store is kept only when a candidate fails. 
+ * Restarts move the last accept along, so an empty span has no match. The 
+ * updates are masks since the compiler turns selects back into branches. 
+ */
+#define LANE_STEP(k) { \
+    const unsigned int t = dfa_lane(fsm, cur[k], (unsigned char)win[pos[k]]); \
+    span[k]->start    = mstart[k]; \
+    span[k]->last     = mlast[k] - mstart[k]; \
+    span[k]->consumed = pos[k] - mstart[k]; \
+    span[k] += (t & WLN_LANE_FAIL) != 0; \
+    const unsigned int mark    = 0u - ((t & (WLN_LANE_FAIL | WLN_LANE_START | WLN_LANE_ACCEPT)) != 0); \
+    const unsigned int restart = 0u - ((t & (WLN_LANE_FAIL | WLN_LANE_START)) != 0); \
+    mlast[k]  += (pos[k] - mlast[k]) & mark; \
+    mstart[k] += (pos[k] - mstart[k]) & restart; \
+    cur[k]    = t & WLN_LANE_STATE; \
+    pos[k]++; \
+  }
+
+  for (unsigned int j = 0; j < steps; j++) {
+    LANE_STEP(0) LANE_STEP(1)
+  }
+  for (unsigned int k = 0; k < WLN_LANES; k++) {
+    while (pos[k] < end[k]) 
+      LANE_STEP(k)
+  }
+#undef LANE_STEP
+
+  for (unsigned int k = 0; k < WLN_LANES; k++) {
+    sc->nstarts += span[k] - span_start[k]; 
+    for (const struct wlnspan *s = span_start[k]; s < span[k]; s++) {
+      if (s->consumed >= WLN_BUF_SIZE)
+        return false; 
     }
-    goto jmp_fetch_data; 
+  }
 
-jmp_matching:
-    for (; i < bytes; i++) { 
-      unsigned char ch = buffer[i]; 
-      jmp_id = state_jmp(curr_id, ch);  
-      if (jmp_id == NO_JMP) {
-        curr_id = root_id; 
-        if (match_end > 0) 
-          handle_match(wln_buf, match_end+1, wlnlen);  
-        else if (opt_match_option == LINE_MATCH)
-          fwrite(wln_buf, wlnlen, 1, stdout); 
-        match_end = 0; 
-        goto jmp_not_matching;
+  /* reconcile, gaps between matches go out as the serial scan skips them */
+  size_t prev = 0; 
+  for (unsigned int k = 0; k < WLN_LANES; k++) {
+    for (const struct wlnspan *s = span_start[k]; s < span[k]; s++) {
+      if (!s->last)
+        continue; 
+      if (opt_match_option == LINE_MATCH)
+        wln_output_write(sc->out, win+prev, s->start-prev); 
+      if (opt_track_lines)
+        sc->lines += count_lines(win+prev, s->start-prev); 
+
+      sc->match_offset = sc->base + start + s->start; 
+      sc->match_line   = sc->lines + 1; 
+      handle_match(sc, win + s->start, s->last + 1, s->consumed); 
+      prev = s->start + s->consumed; 
+    }
+  }
+  if (opt_match_option == LINE_MATCH)
+    wln_output_write(sc->out, win+prev, n-prev); 
+  if (opt_track_lines)
+    sc->lines += count_lines(win+prev, n-prev); 
+  return true; 
+}
+
+
+static void scan_block(struct wlnscan *sc, const char *buffer, size_t bytes)
+{
+  if (opt_exact)
+    return scan_block_exact(sc, buffer, bytes); 
+  if (opt_ocr)
+    return scan_block_fuzzy(sc, buffer, bytes); 
+
+  const struct wln_dfa *fsm = wlnfsm; 
+  size_t i = 0; 
+  while (bytes - i >= WLN_LANE_WINDOW) {
+    const size_t w = i + WLN_LANE_WINDOW; 
+
+    /* the last window decides */
+    const bool dense = sc->nstarts >= WLN_LANE_DENSE; 
+    sc->nstarts = 0; 
+    if (!dense) {
+      scan_serial(sc, buffer, i, w); 
+      i = w; 
+      continue; 
+    }
+
+    /* a match carried in is finished serially, up to the first sync byte */
+    if (sc->matching) {
+      const size_t a = next_sync(fsm, buffer, i, w); 
+      scan_serial(sc, buffer, i, a); 
+      i = a; 
+    }
+
+    size_t b = w; 
+    while (b > i && !dfa_sync(fsm, (unsigned char)buffer[b-1]))
+      b--; 
+
+    /* with nothing to split on, or an overlong candidate, stay serial */
+    if (b == i || !scan_lanes(sc, buffer, i, b)) {
+      if (b == i)
+        b = w; 
+      scan_serial(sc, buffer, i, b); 
+    }
+    i = b; 
+  }
+
+  scan_serial(sc, buffer, i, bytes); 
+  sc->base += bytes; 
+}
+
+
+static void scan_finish(struct wlnscan *sc)
+{
+  /* a last line with no newline */
+  if (opt_exact && sc->matching && is_accept(sc->curr_id))
+    handle_line(sc); 
+  else if (opt_ocr) {
+    /* a candidate live at the end restarts as on a failed byte */
+    while (sc->matching) {
+      const size_t restart = fuzzy_end(sc); 
+      if (restart < sc->base)
+        fuzzy_replay(sc, restart); 
+    }
+  }
+  else if (!opt_exact && sc->match_end > 0) 
+    handle_match(sc, sc->wln_buf, sc->match_end+1, sc->wlnlen);  
+  if (sc->queue)
+    queue_flush(sc); 
+  sc->matching  = false; 
+  sc->curr_id   = 0; 
+  sc->match_end = 0; 
+}
+
+
+static bool process_file(FILE *fp)
+{
+  /* several lane windows per read */
+  const size_t bufsize = 1 << 18; 
+  char *buffer = (char*)malloc(bufsize); 
+
+  struct wln_output out; 
+  wln_output_init(&out, STDOUT_FILENO, latty); 
+
+  struct wlnscan *sc = (struct wlnscan*)malloc(sizeof(struct wlnscan)); 
+  scan_init(sc, &out, ifname); 
+  if (opt_validate)
+    sc->queue = queue_new(opt_threads ? opt_threads : sysconf(_SC_NPROCESSORS_ONLN)); 
+  if (opt_top)
+    sc->top = &top; 
+
+  size_t bytes; 
+  while ((bytes = fread(buffer, 1, bufsize, fp))) {
+    scan_block(sc, buffer, bytes); 
+    wln_output_end(&out); 
+  }
+  scan_finish(sc); 
+
+  nmatches = sc->nmatches; 
+  queue_free(sc->queue); 
+  free(sc); 
+  free(buffer); 
+  wln_output_free(&out); 
+  return true;
+}
+
+
+struct wlnchunk {
+  struct wlnscan sc; 
+  struct wln_output out; 
+  struct wlnqueue *queue; 
+  struct wln_top top;  // --top only, merged once the file is done
+  const char *data; 
+  size_t len; 
+  size_t lines; 
+}; 
+
+
+static void* chunk_worker(void *arg)
+{
+  struct wlnchunk *chunk = (struct wlnchunk*)arg; 
+  scan_block(&chunk->sc, chunk->data, chunk->len); 
+  scan_finish(&chunk->sc); 
+  return NULL; 
+}
+
+
+static void* chunk_count_worker(void *arg)
+{
+  struct wlnchunk *chunk = (struct wlnchunk*)arg; 
+  chunk->lines = count_lines(chunk->data, chunk->len); 
+  return NULL; 
+}
+
+
+/* one thread per chunk, anything a thread could not be made for runs here */
+static void run_chunks(struct wlnchunk *chunks, unsigned int nchunks, 
+                       pthread_t *workers, void* (*worker)(void*))
+{
+  unsigned int nworkers = 0; 
+  for (; nworkers < nchunks; nworkers++) {
+    if (pthread_create(&workers[nworkers], NULL, worker, &chunks[nworkers]) != 0)
+      break; 
+  }
+
+  for (unsigned int i = nworkers; i < nchunks; i++)
+    worker(&chunks[i]); 
+
+  for (unsigned int i = 0; i < nworkers; i++)
+    pthread_join(workers[i], NULL); 
+}
+
+
+/* 
+ * a byte with no transition in any state always returns the automaton to 
+ * the root, so a chunk starting after one scans exactly as it would in a 
+ * single pass and no match can span the edge. Files are processed in 
+ * rounds of one chunk per thread, outputs are written in chunk order.
+ */
+static bool process_file_parallel(FILE *fp)
+{
+  struct stat st; 
+  if (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode) || !st.st_size)
+    return process_file(fp); 
+
+  const size_t size = st.st_size; 
+  const char *data = (const char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0); 
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "Warning: could not map input, reading serially\n"); 
+    return process_file(fp); 
+  }
+  madvise((void*)data, size, MADV_SEQUENTIAL); 
+
+  struct wln_output out; 
+  wln_output_init(&out, STDOUT_FILENO, false); 
+
+  /* chunk buffers stay in memory and are reused every round */
+  struct wlnchunk *chunks = (struct wlnchunk*)malloc(opt_threads*sizeof(struct wlnchunk)); 
+  pthread_t *workers = (pthread_t*)malloc(opt_threads*sizeof(pthread_t)); 
+  /* chunks already run one per thread, their reader batches stay inline */
+  for (unsigned int i = 0; i < opt_threads; i++) {
+    wln_output_init(&chunks[i].out, -1, false); 
+    chunks[i].queue = opt_validate ? queue_new(1) : (struct wlnqueue*)0; 
+    if (opt_top)
+      wln_top_init(&chunks[i].top, WLN_TOP_SLOTS(opt_top)); 
+  }
+
+  nmatches = 0; 
+  size_t pos = 0; 
+  size_t lines = 0; 
+  while (pos < size) {
+    unsigned int nchunks = 0; 
+    for (; nchunks < opt_threads && pos < size; nchunks++) {
+      size_t end = size - pos > WLN_CHUNK_SIZE ? pos + WLN_CHUNK_SIZE : size; 
+      if (opt_exact) {
+        /* anchored chunks have to start on a line */
+        const char *nl = (const char*)memchr(data+end-1, '\n', size-end+1); 
+        end = nl ? nl - data + 1 : size; 
       }
-      else if (wlnlen >= wlnbuf_size) {
-        fprintf(stderr, "Warning: WLN string too long!\n");
-        goto jmp_not_matching;
+      else while (end < size && !wlnfsm_sync((unsigned char)data[end-1]))
+        end++; 
+
+      struct wlnchunk *chunk = &chunks[nchunks]; 
+      chunk->data    = data + pos; 
+      chunk->len     = end - pos; 
+      chunk->out.len = 0; 
+      scan_init(&chunk->sc, &chunk->out, ifname); 
+      chunk->sc.queue = chunk->queue; 
+      chunk->sc.top = opt_top ? &chunk->top : (struct wln_top*)0; 
+      chunk->sc.base = pos; 
+      pos = end; 
+    }
+
+    /* line numbers need the newlines of every earlier chunk, counted first */
+    if (opt_track_lines) {
+      run_chunks(chunks, nchunks, workers, chunk_count_worker); 
+      for (unsigned int i = 0; i < nchunks; i++) {
+        chunks[i].sc.lines = lines; 
+        lines += chunks[i].lines; 
       }
-      else {
-        curr_id = jmp_id; 
-        wln_buf[wlnlen] = ch; 
-        match_end = is_accept(curr_id) ? wlnlen : match_end; 
-        wlnlen++; 
+    }
+
+    run_chunks(chunks, nchunks, workers, chunk_worker); 
+
+    for (unsigned int i = 0; i < nchunks; i++) {
+      wln_output_write(&out, chunks[i].out.buf, chunks[i].out.len); 
+      nmatches += chunks[i].sc.nmatches; 
+    }
+  }
+
+  for (unsigned int i = 0; i < opt_threads; i++) {
+    wln_output_free(&chunks[i].out); 
+    queue_free(chunks[i].queue); 
+    if (opt_top) {
+      wln_top_merge(&top, &chunks[i].top); 
+      wln_top_free(&chunks[i].top); 
+    }
+  }
+  wln_output_free(&out); 
+  free(workers); 
+  free(chunks); 
+  munmap((void*)data, size); 
+  return true; 
+}
+
+
+static void add_file(const char *path)
+{
+  if (nfiles == files_alloc) {
+    files_alloc = files_alloc ? files_alloc * 2 : 64; 
+    files = (char**)realloc(files, files_alloc*sizeof(char*)); 
+  }
+  files[nfiles++] = strdup(path); 
+}
+
+
+static int collect_file(const char *path, const struct stat *st, int flag, struct FTW *)
+{
+  if (flag == FTW_F && S_ISREG(st->st_mode))
+    add_file(path); 
+  else if (flag == FTW_DNR)
+    fprintf(stderr, "Warning: could not read directory %s\n", path); 
+  return 0; 
+}
+
+
+/* each output line of a file goes out behind its name, as grep does */
+static void prefix_lines(struct wln_output *out, const char *path, 
+                         const char *buf, size_t len)
+{
+  const size_t plen = strlen(path); 
+  const char *end = buf + len; 
+  while (buf < end) {
+    const char *nl = (const char*)memchr(buf, '\n', end - buf); 
+    const char *stop = nl ? nl + 1 : end; 
+    wln_output_write(out, path, plen); 
+    wln_output_write(out, ":", 1); 
+    wln_output_write(out, buf, stop - buf); 
+    buf = stop; 
+  }
+  if (len && end[-1] != '\n')
+    wln_output_write(out, "\n", 1); 
+}
+
+
+struct wlnpool {
+  unsigned int next; 
+  bool failed;   // a file could not be opened or read
+  pthread_mutex_t lock; 
+  struct wln_output out; 
+}; 
+
+
+/* 
+ * hands the whole lines of a file's output to the shared writer, the last 
+ * call also takes a trailing partial line. The prefix goes in as the lines 
+ * are copied under the lock, so nothing is staged twice.
+ */
+static void file_drain(struct wlnpool *pool, const char *path, struct wln_output *out, bool last)
+{
+  size_t n = out->len; 
+  if (!last) {
+    while (n && out->buf[n-1] != '\n')
+      n--; 
+  }
+  if (!n)
+    return; 
+
+  pthread_mutex_lock(&pool->lock); 
+  /* json records already carry the file */
+  if (opt_match_option == JSON_MATCH)
+    wln_output_write(&pool->out, out->buf, n); 
+  else
+    prefix_lines(&pool->out, path, out->buf, n); 
+  pthread_mutex_unlock(&pool->lock); 
+
+  out->len -= n; 
+  memmove(out->buf, out->buf + n, out->len); 
+}
+
+
+/* 
+ * workers claim whole files through an atomic index and stream each file's 
+ * output to the shared writer once a buffer of it is ready, a file under 
+ * that size is written as one group. Counts and --top summaries are kept 
+ * per worker and added once at exit. 
+ */
+static void* file_worker(void *arg)
+{
+  struct wlnpool *pool = (struct wlnpool*)arg; 
+  const size_t bufsize = 65536; 
+  char *buffer = (char*)malloc(bufsize); 
+
+  struct wln_output scan_out; 
+  wln_output_init(&scan_out, -1, false); 
+
+  struct wlnscan *sc = (struct wlnscan*)malloc(sizeof(struct wlnscan)); 
+  struct wlnqueue *queue = opt_validate ? queue_new(1) : (struct wlnqueue*)0; 
+  unsigned long count = 0; 
+
+  struct wln_top local; 
+  if (opt_top)
+    wln_top_init(&local, WLN_TOP_SLOTS(opt_top)); 
+
+  while (true) {
+    const unsigned int f = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED); 
+    if (f >= nfiles)
+      break; 
+
+    const char *path = files[f]; 
+    int fd = strcmp(path, "-") ? open(path, O_RDONLY) : STDIN_FILENO; 
+    if (fd < 0) {
+      fprintf(stderr, "Error: could not open file at %s\n", path); 
+      __atomic_store_n(&pool->failed, true, __ATOMIC_RELAXED); 
+      continue; 
+    }
+
+    scan_out.len = 0; 
+    scan_init(sc, &scan_out, path); 
+    sc->queue = queue; 
+    sc->top = opt_top ? &local : (struct wln_top*)0; 
+
+    ssize_t bytes; 
+    while ((bytes = read(fd, buffer, bufsize)) != 0) {
+      if (bytes < 0) {
+        if (errno == EINTR)
+          continue; 
+        fprintf(stderr, "Error: could not read file at %s\n", path); 
+        __atomic_store_n(&pool->failed, true, __ATOMIC_RELAXED); 
+        break; 
       }
+      scan_block(sc, buffer, bytes); 
+      if (scan_out.len >= WLN_OUTPUT_SIZE)
+        file_drain(pool, path, &scan_out, false); 
     }
-    goto jmp_fetch_data; 
+    scan_finish(sc); 
+    if (fd != STDIN_FILENO)
+      close(fd); 
+
+    count += sc->nmatches; 
+    file_drain(pool, path, &scan_out, true); 
   }
-  
-  return true;
+
+  __atomic_fetch_add(&nmatches, count, __ATOMIC_RELAXED); 
+  if (opt_top) {
+    pthread_mutex_lock(&pool->lock); 
+    wln_top_merge(&top, &local); 
+    pthread_mutex_unlock(&pool->lock); 
+    wln_top_free(&local); 
+  }
+  wln_output_free(&scan_out); 
+  queue_free(queue); 
+  free(sc); 
+  free(buffer); 
+  return NULL; 
+}
+
+
+static bool process_files()
+{
+  struct wlnpool pool; 
+  pool.next = 0; 
+  pool.failed = false; 
+
+  for (unsigned int i = 0; i < nargs; i++) {
+    struct stat st; 
+    if (!strcmp(args[i], "-"))
+      add_file(args[i]); 
+    else if (stat(args[i], &st) != 0) {
+      fprintf(stderr, "Error: could not open file at %s\n", args[i]); 
+      pool.failed = true; 
+    }
+    else if (!S_ISDIR(st.st_mode))
+      add_file(args[i]); 
+    else if (!opt_recursive)
+      fprintf(stderr, "Warning: %s is a directory, use -r\n", args[i]); 
+    else if (nftw(args[i], collect_file, 64, FTW_PHYS) != 0)
+      fprintf(stderr, "Warning: could not walk %s\n", args[i]); 
+  }
+
+  unsigned int nthreads = opt_threads ? opt_threads : sysconf(_SC_NPROCESSORS_ONLN); 
+  if (nthreads > nfiles)
+    nthreads = nfiles ? nfiles : 1; 
+
+  pthread_mutex_init(&pool.lock, NULL); 
+  wln_output_init(&pool.out, STDOUT_FILENO, latty); 
+
+  nmatches = 0; 
+  pthread_t *workers = (pthread_t*)malloc(nthreads*sizeof(pthread_t)); 
+  unsigned int nworkers = 0; 
+  for (; nworkers < nthreads; nworkers++) {
+    if (pthread_create(&workers[nworkers], NULL, file_worker, &pool) != 0)
+      break; 
+  }
+
+  if (!nworkers)
+    file_worker(&pool); 
+  for (unsigned int i = 0; i < nworkers; i++)
+    pthread_join(workers[i], NULL); 
+
+  wln_output_free(&pool.out); 
+  pthread_mutex_destroy(&pool.lock); 
+  free(workers); 
+
+  for (unsigned int i = 0; i < nfiles; i++)
+    free(files[i]); 
+  free(files); 
+  return !pool.failed; 
+}
+
+
+/* the --top listing, count then match as uniq -c gives them */
+static void write_top()
+{
+  struct wln_output out; 
+  wln_output_init(&out, STDOUT_FILENO, false); 
+
+  const unsigned int n = wln_top_sort(&top); 
+  for (unsigned int i = 0; i < n && i < opt_top; i++) {
+    write_number(&out, top.entries[i].count); 
+    wln_output_write(&out, "\t", 1); 
+    wln_output_write(&out, top.entries[i].str, top.entries[i].len); 
+    wln_output_write(&out, "\n", 1); 
+  }
+  wln_output_free(&out); 
 }
 
 
 static void display_usage()
 {
-  fprintf(stderr, "usage: wlngrep <options> <file>\n");
+  fprintf(stderr, "usage: wlngrep <options> <file> ...\n");
   fprintf(stderr, "options:\n");
   fprintf(stderr, "-c|--only-count        return number of matches instead of string\n");
+  fprintf(stderr, "-j<n>                  use n threads, all cores if n is omitted. A single file is mapped\n"
+                  "                       and split, several files are shared out whole\n");
+  fprintf(stderr, "-b|--byte-offset       print the byte offset of each match, implies -o\n");
+  fprintf(stderr, "-n|--line-number       print the line number of each match, implies -o\n");
   fprintf(stderr, "-o|--only-match        print only the matched parts of line\n");
+  fprintf(stderr, "-x|--exact             only report lines that are entirely WLN\n");
+  fprintf(stderr, "--json                 print one {file, offset, line, match} object per match\n");
+  fprintf(stderr, "--top <k>              print the k most frequent matches and their counts, k is at most %u.\n"
+                  "                       Memory is bounded, past %u or 64*k distinct matches, whichever is\n"
+                  "                       larger, the counts are upper bounds\n", WLN_TOP_MAX, WLN_TOP_SLOTS(0));
+  fprintf(stderr, "-r|--recursive         search directories, lines are prefixed with their file\n");
+  fprintf(stderr, "--validate             keep only matches the reader parses, implies -o\n");
+  fprintf(stderr, "--convert -o<format>   print each valid match and its conversion (-osmi, -oinchi, -ocan)\n");
+  fprintf(stderr, "--ocr[=<n>]            allow up to n (default 1, at most %u) OCR errors per match, 0/O 1/I 5/S\n"
+                  "                       swaps and dropped spaces. Matches are printed corrected with their\n"
+                  "                       edit count\n", WLN_FUZZY_MAX);
+  fprintf(stderr, "dialects:\n");
+  fprintf(stderr, "--c-symbol             match the C symbol, off by default as it matches SMILES chains\n");
+  fprintf(stderr, "--no-ions              do not join ionic components on ' &'\n");
+  fprintf(stderr, "--no-spiro             do not match inline spiro ring definitions\n");
+  fprintf(stderr, "--no-multicyclic       do not match multicyclic ring blocks\n");
+  fprintf(stderr, "--strict               core grammar only, all of the above off\n");
+  fprintf(stderr, "--permissive           every dialect on, including the C symbol\n");
   exit(1);
 }
 
@@ -390,24 +1322,90 @@ static void process_cml(int argc, char *argv[])
 {
   const char *ptr;
   opt_match_option = LINE_MATCH; 
-
-  int i, j;
-  j = 0;
+  opt_threads = 0; 
+  opt_recursive = false; 
+  opt_line_number = false; 
+  opt_byte_offset = false; 
+  opt_exact = false; 
+  opt_ocr = 0; 
+  opt_top = 0; 
+  opt_dialect = WLN_DIALECT_DEFAULT; 
+  opt_validate = false; 
+  opt_convert = false; 
+  format = (const char*)0; 
+
+  args = (const char**)malloc(argc*sizeof(char*)); 
+  nargs = 0; 
+
+  int i;
   for (i = 1; i < argc; i++) {
     ptr = argv[i];
-    if (ptr[0] == '-' && !ptr[1]) {
-      ifp = stdin; 
-      j++;
-    }
     if (ptr[0] == '-' && ptr[1]) switch (ptr[1]) {
+      case 'b': opt_byte_offset = true; break;
       case 'c': opt_match_option = COUNT_ONLY; break;
-      case 'o': opt_match_option = MATCH_ONLY; break;
+      case 'j': 
+        opt_threads = ptr[2] ? strtoul(ptr+2, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN); 
+        if (!opt_threads) {
+          fprintf(stderr, "Error: invalid thread count %s\n", ptr);
+          display_usage();
+        }
+        break;
+      case 'n': opt_line_number = true; break;
+      case 'o': 
+        if (ptr[2])
+          format = ptr+2; 
+        else
+          opt_match_option = MATCH_ONLY; 
+        break;
+      case 'r': opt_recursive = true; break;
+      case 'x': opt_exact = true; break;
 
       case '-':
         if (!strcmp(ptr,"--only-count"))
           opt_match_option = COUNT_ONLY;
         else if (!strcmp(ptr,"--only-match"))
           opt_match_option = MATCH_ONLY;
+        else if (!strcmp(ptr,"--recursive"))
+          opt_recursive = true;
+        else if (!strcmp(ptr,"--byte-offset"))
+          opt_byte_offset = true;
+        else if (!strcmp(ptr,"--line-number"))
+          opt_line_number = true;
+        else if (!strcmp(ptr,"--exact"))
+          opt_exact = true;
+        else if (!strcmp(ptr,"--json"))
+          opt_match_option = JSON_MATCH;
+        else if (!strcmp(ptr,"--top")) {
+          unsigned long k = i+1 < argc ? strtoul(argv[++i], NULL, 10) : 0; 
+          if (!k) {
+            fprintf(stderr, "Error: --top needs a count above zero\n");
+            display_usage();
+          }
+          opt_top = k < WLN_TOP_MAX ? k : WLN_TOP_MAX; 
+        }
+        else if (!strcmp(ptr,"--c-symbol"))
+          opt_dialect |= WLN_DIALECT_C;
+        else if (!strcmp(ptr,"--no-ions"))
+          opt_dialect &= ~WLN_DIALECT_IONS;
+        else if (!strcmp(ptr,"--no-spiro"))
+          opt_dialect &= ~WLN_DIALECT_SPIRO;
+        else if (!strcmp(ptr,"--no-multicyclic"))
+          opt_dialect &= ~WLN_DIALECT_MULTICYCLIC;
+        else if (!strcmp(ptr,"--strict"))
+          opt_dialect = 0;
+        else if (!strcmp(ptr,"--permissive"))
+          opt_dialect = WLN_DIALECTS-1;
+        else if (!strcmp(ptr,"--validate"))
+          opt_validate = true;
+        else if (!strcmp(ptr,"--convert"))
+          opt_convert = true;
+        else if (!strncmp(ptr,"--ocr",5) && (!ptr[5] || ptr[5] == '=')) {
+          opt_ocr = ptr[5] ? strtoul(ptr+6, NULL, 10) : 1; 
+          if (!opt_ocr || opt_ocr > WLN_FUZZY_MAX) {
+            fprintf(stderr, "Error: invalid edit budget %s\n", ptr);
+            display_usage();
+          }
+        }
         else {
           fprintf(stderr, "Error: unrecognised input %s\n", ptr);
           display_usage();
@@ -418,19 +1416,56 @@ static void process_cml(int argc, char *argv[])
         fprintf(stderr, "Error: unrecognised input %s\n", ptr);
         display_usage();
     }
-    else switch (j++) {
-      case 0: 
-        ifp = fopen(ptr, "r");  
-        if (!ifp) {
-          fprintf(stderr, "Error: could not open file at %s\n", ptr); 
-          display_usage(); 
-        }
-        break; 
-    }
+    else 
+      args[nargs++] = ptr; 
   }
-  
-  if (!j)
+
+  if (opt_convert && !format) {
+    fprintf(stderr, "Error: --convert needs an output format\n");
+    display_usage();
+  }
+  if (format && !opt_convert) {
+    fprintf(stderr, "Error: -o%s is only used with --convert\n", format);
+    display_usage();
+  }
+  /* the summary replaces every other report of the matches */
+  if (opt_top && (opt_match_option != LINE_MATCH || opt_line_number || opt_byte_offset || opt_convert)) {
+    fprintf(stderr, "Error: --top does not combine with -c, -o, -n, -b, --json or --convert\n");
+    display_usage();
+  }
+  opt_validate = opt_validate || opt_convert; 
+  if (opt_top)
+    opt_match_option = TOP_MATCH; 
+
+  if (opt_ocr && opt_exact) {
+    fprintf(stderr, "Error: --ocr does not combine with -x\n");
+    display_usage();
+  }
+
+  /* locations and parse results are reported per match */
+  if ((opt_line_number || opt_byte_offset || opt_validate) && opt_match_option == LINE_MATCH)
+    opt_match_option = MATCH_ONLY; 
+  opt_track_lines = opt_match_option == JSON_MATCH || 
+                    (opt_line_number && opt_match_option == MATCH_ONLY); 
+
+  /* like grep, a recursive search with no inputs starts here */
+  if (opt_recursive && !nargs)
+    args[nargs++] = "."; 
+
+  if (nargs > 1 || opt_recursive) 
+    ifp = (FILE*)0; 
+  else if (!nargs || !strcmp(args[0], "-")) {
     ifp = stdin;
+    ifname = "(standard input)"; 
+  }
+  else {
+    ifname = args[0]; 
+    ifp = fopen(args[0], "r");  
+    if (!ifp) {
+      fprintf(stderr, "Error: could not open file at %s\n", args[0]); 
+      display_usage(); 
+    }
+  }
   return;
 }
 
@@ -439,16 +1474,28 @@ int main(int argc, char* argv[])
 {
   latty = isatty(STDOUT_FILENO) ? 0xff:0x0; 
   process_cml(argc,argv); 
-
-  init_wlnfsm(); 
-
-  process_file(ifp);  
+  wlnfsm_select(opt_dialect); 
+  if (opt_top)
+    wln_top_init(&top, WLN_TOP_SLOTS(opt_top)); 
+
+  bool ok = true; 
+  if (!ifp)
+    ok = process_files(); 
+  else if (opt_threads)
+    process_file_parallel(ifp); 
+  else
+    process_file(ifp);  
   if (opt_match_option == COUNT_ONLY)
     printf("%lu matches\n", nmatches); 
+  else if (opt_match_option == TOP_MATCH) {
+    write_top(); 
+    wln_top_free(&top); 
+  }
   
-  if (ifp != stdin) 
+  if (ifp && ifp != stdin) 
     fclose(ifp); 
-  return 0;
+  free(args); 
+  return ok ? 0 : 1;
 }
 
 
@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "wlnoutput.h"
+
+
+void wln_output_init(struct wln_output *out, int fd, bool line_flush)
+{
+  out->buf   = (char*)malloc(WLN_OUTPUT_SIZE);
+  out->len   = 0;
+  out->alloc = WLN_OUTPUT_SIZE;
+  out->fd    = fd;
+  out->line_flush = line_flush;
+}
+
+
+void wln_output_free(struct wln_output *out)
+{
+  wln_output_flush(out);
+  free(out->buf);
+  out->buf   = (char*)0;
+  out->alloc = 0;
+}
+
+
+/* writes all n bytes, retrying short writes and interrupts */
+static bool write_all(int fd, const char *ptr, size_t n)
+{
+  while (n) {
+    ssize_t w = write(fd, ptr, n);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      fprintf(stderr, "Error: output write failed - %s\n", strerror(errno));
+      return false;
+    }
+    ptr += w;
+    n -= w;
+  }
+  return true;
+}
+
+
+bool wln_output_flush(struct wln_output *out)
+{
+  if (out->fd < 0)
+    return true;
+
+  const size_t n = out->len;
+  out->len = 0;
+  return write_all(out->fd, out->buf, n);
+}
+
+
+void wln_output_write(struct wln_output *out, const char *str, size_t n)
+{
+  if (out->len + n > out->alloc) {
+    if (out->fd < 0) {
+      while (out->len + n > out->alloc)
+        out->alloc *= 2;
+      out->buf = (char*)realloc(out->buf, out->alloc);
+    }
+    else {
+      wln_output_flush(out);
+      if (n > out->alloc) {
+        /* larger than the whole buffer, pass it straight through */
+        write_all(out->fd, str, n);
+        return;
+      }
+    }
+  }
+
+  memcpy(out->buf + out->len, str, n);
+  out->len += n;
+}
+
+
+void wln_output_line(struct wln_output *out, const char *str)
+{
+  wln_output_write(out, str, strlen(str));
+  wln_output_write(out, "\n", 1);
+  wln_output_end(out);
+}
+
+
+void wln_output_end(struct wln_output *out)
+{
+  if (out->line_flush)
+    wln_output_flush(out);
+}
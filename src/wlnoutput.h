@@ -0,0 +1,36 @@
+#ifndef WLN_OUTPUT_H
+#define WLN_OUTPUT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * buffered record output for the command line tools. Records are formatted
+ * straight into one large buffer which goes out in big write(2) calls,
+ * line flush mode hands every record over as it completes for interactive
+ * pipes. An fd of -1 keeps everything in memory, the buffer grows instead
+ * of flushing. One writer per thread, nothing here is locked.
+ */
+
+#define WLN_OUTPUT_SIZE (1 << 18)
+
+struct wln_output {
+  char *buf;
+  size_t len;
+  size_t alloc;
+  int fd;
+  bool line_flush;
+};
+
+void wln_output_init(struct wln_output *out, int fd, bool line_flush);
+void wln_output_free(struct wln_output *out);
+
+/* appends n bytes, flushing first if they would not fit */
+void wln_output_write(struct wln_output *out, const char *str, size_t n);
+void wln_output_line(struct wln_output *out, const char *str);
+
+/* marks the end of a record, only flushes in line flush mode */
+void wln_output_end(struct wln_output *out);
+bool wln_output_flush(struct wln_output *out);
+
+#endif
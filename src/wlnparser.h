@@ -3,11 +3,101 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include <openbabel/mol.h>
 #include <openbabel/obconversion.h>
 
 bool ReadWLN(const char *buffer, OpenBabel::OBMol* mol); 
+
+/* 
+ * runs the reader grammar and locant range checks without building a 
+ * molecule, failures fill the same error record as ReadWLN.
+ */
+bool ValidateWLN(const char *buffer); 
+
+/* error codes of a failed read */
+#define WLN_ERR_NONE        0
+#define WLN_ERR_SYNTAX      1
+#define WLN_ERR_CHARACTER   2
+#define WLN_ERR_SYMBOL      3
+#define WLN_ERR_LOCANT      4
+#define WLN_ERR_RING        5
+#define WLN_ERR_UNSUPPORTED 6
+#define WLN_ERR_EMPTY       7
+#define WLN_ERR_TRAILING    8
+#define WLN_ERR_MAX         9
+
+struct wln_parse_error {
+  int code; 
+  size_t offset;    /* byte offset of the offending character */
+  unsigned char ch; /* the offending character */
+};
+
+/* 
+ * error record of the last read on the calling thread, code is WLN_ERR_NONE 
+ * after a successful read. Nothing is printed unless logging is turned on, 
+ * which writes a formatted message to stderr for every failed read.
+ */
+const struct wln_parse_error* WLNLastError(); 
+const char* WLNErrorString(int code); 
+void WLNSetLogging(bool log); 
+
+/* 
+ * upper bound on the atoms a notation reads into, used by ReadWLN to reserve 
+ * the molecule up front. The bond bound is written to nbonds if not NULL.
+ */
+unsigned int EstimateWLN(const char *buffer, unsigned int *nbonds); 
+
+/* 
+ * called once per record of a batch read, the molecule is only valid for the 
+ * duration of the call. With more than one thread the callback is called 
+ * concurrently, each worker passing its own molecule. 
+ */
+typedef void (*wln_read_callback)(unsigned int record, bool ok, OpenBabel::OBMol* mol, void *data); 
+
+struct wln_batch_summary {
+  unsigned int nread; 
+  unsigned int nfailed; 
+  unsigned int ncodes[WLN_ERR_MAX]; /* failed records per error code */
+};
+
+/* 
+ * reads nrecords WLN strings, record i being the bytes buffer[offsets[i]] up 
+ * to buffer[offsets[i+1]]. Nothing is written to stderr, WLNLastError() is 
+ * valid inside the callback, and summary if not NULL tallies the failures. 
+ * Returns the number of records successfully read.
+ */
+unsigned int ReadWLNBatch(const char *buffer, const size_t *offsets, unsigned int nrecords, 
+                          wln_read_callback callback, void *data, unsigned int nthreads, 
+                          struct wln_batch_summary *summary); 
+
+/* 
+ * ValidateWLN over a batch laid out as for ReadWLNBatch, valid[i] is set per 
+ * record. Returns the number of valid records.
+ */
+unsigned int ValidateWLNBatch(const char *buffer, const size_t *offsets, unsigned int nrecords, 
+                              bool *valid, unsigned int nthreads); 
+
+/* returns false if the molecule cannot be written, or the notation and its 
+ * terminator do not fit in nbuffer bytes */
 bool WriteWLN(char *buffer, unsigned int nbuffer, OpenBabel::OBMol* mol); 
 
+/* 
+ * getline style write, *buffer is grown with realloc to fit the notation and 
+ * may start as NULL, *nbuffer holding its allocated size. Returns the length 
+ * of the notation, or -1 if the molecule cannot be written.
+ */
+long WriteWLNString(char **buffer, size_t *nbuffer, OpenBabel::OBMol* mol); 
+
+/* 
+ * writes nmols WLN strings back to back into *arena, which is grown with realloc 
+ * and may start as NULL, *narena holding its allocated size. String i is the 
+ * bytes (*arena)[offsets[i]] up to (*arena)[offsets[i+1]], empty if the write 
+ * failed, offsets must hold nmols+1 entries. Returns the number of molecules 
+ * written. 
+ */
+unsigned int WriteWLNBatch(OpenBabel::OBMol** mols, unsigned int nmols, char **arena, size_t *narena, 
+                           size_t *offsets, unsigned int nthreads); 
+
 #endif 
@@ -28,6 +28,7 @@ GNU General Public License for more details.
 
 #include <errno.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <openbabel/mol.h>
 #include <openbabel/atom.h>
@@ -39,6 +40,7 @@ GNU General Public License for more details.
 #include <openbabel/obconversion.h>
 
 #include "wlnparser.h"
+#include "wlnelements.h"
 
 // Element "magic numbers"
 #define DUM   0
@@ -59,19 +61,63 @@ GNU General Public License for more details.
 // allows mask on ring
 #define WLN_MAX sizeof(unsigned long long) * 8 
 
-char *wln_ptr; 
+// longest carbon run read from one chain number, the estimate caps the same
+#define WLN_CHAIN_MAX 65535
 
-static int wln_error(const char *format, ...) 
+/* parse state is per thread, allows batch reads to fan out */
+static thread_local char *wln_ptr; 
+static thread_local const char *wln_start; 
+static thread_local struct wln_parse_error wln_err; 
+static thread_local bool wln_quiet; 
+
+/* formatted messages are opt-in, a failed read otherwise only fills wln_err */
+static bool wln_logging = false; 
+
+/* 
+ * acyclic strings take the chain only parse. Only testwln, built with 
+ * WLN_TEST_HOOKS, can turn this off to check one path against the other.
+ */
+#ifdef WLN_TEST_HOOKS
+static bool wln_chain_path = true; 
+#else
+static const bool wln_chain_path = true; 
+#endif
+
+/* keeps the first error of a read, which is the innermost failure */
+static int wln_error(int code, const char *format, ...) 
 {
+  if (wln_err.code != WLN_ERR_NONE)
+    return WLN_ERROR; 
+
+  wln_err.code   = code; 
+  wln_err.offset = wln_ptr > wln_start ? wln_ptr - wln_start - 1 : 0; 
+  wln_err.ch     = wln_start[wln_err.offset]; 
+  if (!wln_logging || wln_quiet)
+    return WLN_ERROR; 
+
   va_list args;
   va_start(args, format);
-  fprintf(stderr, "Error: ");  
+  fprintf(stderr, "Error (offset %lu): ", (unsigned long)wln_err.offset);  
   vfprintf(stderr, format, args); 
   va_end(args); 
   return WLN_ERROR;  
 }
 
 
+/* non-fatal, the read carries on so nothing is recorded */
+static void wln_warning(const char *format, ...) 
+{
+  if (!wln_logging || wln_quiet)
+    return; 
+
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "Warning (offset %lu): ", (unsigned long)(wln_ptr - wln_start));  
+  vfprintf(stderr, format, args); 
+  va_end(args); 
+}
+
+
 #ifdef USING_OPENBABEL
 using namespace OpenBabel;
 #define graph_t    OBMol
@@ -79,6 +125,7 @@ using namespace OpenBabel;
 #define edge_t     OBBond
 
 #define symbol_get_id(s)            s->GetId()
+#define symbol_get_idx(s)           s->GetIdx()
 #define symbol_get_num(s)           s->GetAtomicNum()
 #define symbol_set_num(s, n)        s->SetAtomicNum(n)
 #define symbol_get_charge(s)        s->GetFormalCharge()
@@ -103,10 +150,13 @@ using namespace OpenBabel;
 #define graph_new_symbol(g)         g->NewAtom()
 #define graph_new_edge(g)           g->NewBond()
 #define graph_set_edge(g,e)         g->AddBond(*e)
+#define graph_add_bond(g,b,e,o)     g->AddBond(b,e,o)
 #define graph_get_edge(g,x,y)       g->GetBond(x,y)
 #define graph_delete_symbol(g,s)    g->DeleteAtom(s)
 #define graph_delete_edge(g,e)      g->DeleteBond(e)
 #define graph_num_atoms(g)          g->NumAtoms()
+#define graph_clear(g)              g->Clear()
+#define graph_reserve(g,n)          g->ReserveAtoms(n)
 
 #define graph_symbol_iter(s, g)     FOR_ATOMS_OF_MOL(s,g)
 #define graph_edge_iter(e, g)       FOR_BONDS_OF_MOL(e,g)
@@ -115,9 +165,6 @@ using namespace OpenBabel;
 
 #endif
 
-static int start_wln_parse(graph_t *mol); 
-static int branch_recursive_parse(graph_t *mol, symbol_t *symbol, edge_t *edge, struct wlnpath *ring); 
-static int parse_ring_locants(graph_t *mol, struct wlnpath *ring); 
 
 
 static symbol_t*  symbol_create(graph_t *mol, uint16_t atomic_num)
@@ -138,279 +185,92 @@ static edge_t* edge_create(graph_t *mol, symbol_t *parent) {
 
 static bool edge_bond(graph_t *mol, edge_t *bond, symbol_t *child)
 {
-  fprintf(stderr, "order: %d\n", bond->GetBondOrder()); 
   edge_set_end(bond, child); 
   graph_set_edge(mol, bond);
   return true; 
 }
 
 
-static symbol_t* symbol_change(symbol_t *s, uint16_t atomic_num)
-{
-  symbol_set_num(s, atomic_num);
-  return s; 
-}
-
-
-static symbol_t* dash_symbol_create(graph_t *mol, char **wln) 
+/* 
+ * bonds a run of n carbons onto edge, returning the open edge of the last. 
+ * Only the first carbon takes the open edge, the run itself is made in one 
+ * step by index with no edge held per carbon. 
+ */
+static edge_t* chain_create(graph_t *mol, edge_t *edge, unsigned int n, symbol_t **last)
 {
-  char *ptr = *wln;
-  unsigned char fst_ch = *ptr++; // this is known to not be null
-  unsigned char snd_ch = *ptr++; // this could be null (C-string safe)
-
-  if (snd_ch && *ptr != '-')
-    return NULL;
-  else 
-    *wln = ++ptr;
-
-  switch (fst_ch){
-    case 'A':
-      switch (snd_ch) {
-        case 'C': return symbol_create(mol,89);
-        case 'G': return symbol_create(mol,47);
-        case 'L': return symbol_create(mol,13);
-        case 'M': return symbol_create(mol,95);
-        case 'R': return symbol_create(mol,18);
-        case 'S': return symbol_create(mol,33);
-        case 'T': return symbol_create(mol,85);
-        case 'U': return symbol_create(mol,79);
-      }
-      break; 
-
-    case 'B':
-      switch (snd_ch) {
-        case 0:   return symbol_create(mol,BOR);
-        case 'A': return symbol_create(mol,56);
-        case 'E': return symbol_create(mol,4);
-        case 'H': return symbol_create(mol,107);
-        case 'I': return symbol_create(mol,83);
-        case 'K': return symbol_create(mol,97);
-        case 'R': return symbol_create(mol,BRO);
-      }
-      break; 
-
-    case 'C':
-      switch (snd_ch) {
-        case 0:   return symbol_create(mol,CAR);
-        case 'A': return symbol_create(mol,20);
-        case 'D': return symbol_create(mol,48);
-        case 'E': return symbol_create(mol,58);
-        case 'F': return symbol_create(mol,98);
-        case 'M': return symbol_create(mol,96);
-        case 'N': return symbol_create(mol,112);
-        case 'O': return symbol_create(mol,27);
-        case 'R': return symbol_create(mol,24);
-        case 'S': return symbol_create(mol,55);
-        case 'U': return symbol_create(mol,29);
-      }
-      break; 
-
-    case 'D':
-      switch (snd_ch) {
-        case 'B': return symbol_create(mol,105);
-        case 'S': return symbol_create(mol,110);
-        case 'Y': return symbol_create(mol,66);
-      }
-      break;
-
-    case 'E':
-      switch (snd_ch) {
-        case 0:   return symbol_create(mol,35);
-        case 'R': return symbol_create(mol,68);
-        case 'S': return symbol_create(mol,99);
-        case 'U': return symbol_create(mol,63);
-      }
-      break; 
-
-    case 'F':
-      switch (snd_ch) {
-        case 0:   return symbol_create(mol,FLU);
-        case 'E': return symbol_create(mol,26);
-        case 'L': return symbol_create(mol,114);
-        case 'M': return symbol_create(mol,100);
-        case 'R': return symbol_create(mol,87);
-      }
-      break;
-
-    case 'G':
-      switch (snd_ch) {
-        case 0:   return symbol_create(mol,CHL);
-        case 'A': return symbol_create(mol,31);
-        case 'D': return symbol_create(mol,64);
-        case 'E': return symbol_create(mol,32);
-      }
-      break;
-
-    case 'H':
-      switch (snd_ch) {
-        case 'E': return symbol_create(mol,2);
-        case 'F': return symbol_create(mol,72);
-        case 'G': return symbol_create(mol,80);
-        case 'O': return symbol_create(mol,67);
-        case 'S': return symbol_create(mol,108);
-      }
-      break;
+  if (!n)
+    return edge; 
 
-    case 'I':
-      switch (snd_ch) {
-        case 0:  return symbol_create(mol,IOD);
-        case 'N': return symbol_create(mol,49);
-        case 'R': return symbol_create(mol,77);
-      }
-      break;
+  symbol_t *carbon = symbol_create(mol, CAR); 
+  edge_bond(mol, edge, carbon); 
 
-    case 'K':
-      switch (snd_ch) {
-        case 0:   return symbol_create(mol,NIT);
-        case 'R': return symbol_create(mol,36);
-        case 'A': return symbol_create(mol,19);
-      }
-      break;
+  unsigned int idx = symbol_get_idx(carbon); 
+  for (unsigned int i=1; i<n; i++) {
+    carbon = symbol_create(mol, CAR); 
+    graph_add_bond(mol, idx, idx+1, 1); 
+    idx++; 
+  }
+  *last = carbon; 
+  return edge_create(mol, carbon); 
+}
 
-    case 'L':
-      switch (snd_ch) {
-        case 'A': return symbol_create(mol,57);
-        case 'I': return symbol_create(mol,3);
-        case 'R': return symbol_create(mol,103);
-        case 'U': return symbol_create(mol,71);
-        case 'V': return symbol_create(mol,116);
-      }
-      break;
 
-    case 'M':
-      switch (snd_ch) {
-        case 0: return symbol_create(mol,NIT);
-        case 'C': return symbol_create(mol,115);
-        case 'D': return symbol_create(mol,101);
-        case 'G': return symbol_create(mol,12);
-        case 'N': return symbol_create(mol,25);
-        case 'O': return symbol_create(mol,42);
-        case 'T': return symbol_create(mol,109);
-      }
-      break;
+/*
+ * ReadWLN and ValidateWLN share one walker templated on BUILD. A validating
+ * walk makes no molecule, tokens stand in for its symbols and edges and the
+ * symbols a read would make are only counted.
+ */
+static uint64_t wln_token[3];
+#define TOKEN_SYMBOL      ((symbol_t*)&wln_token[0])
+#define TOKEN_EDGE        ((edge_t*)&wln_token[1])
+#define TOKEN_DUMMY_EDGE  ((edge_t*)&wln_token[2]) /* hangs from the component dummy */
 
-    case 'N':
-      switch (snd_ch) {
-        case 0: return symbol_create(mol,NIT);
-        case 'A': return symbol_create(mol,11);
-        case 'B': return symbol_create(mol,41);
-        case 'D': return symbol_create(mol,60);
-        case 'E': return symbol_create(mol,10);
-        case 'H': return symbol_create(mol,113);
-        case 'I': return symbol_create(mol,28);
-        case 'O': return symbol_create(mol,102);
-        case 'P': return symbol_create(mol,93);
-      }
-      break; 
+static thread_local unsigned int wln_nsymbols;
 
-    case 'O':
-      switch (snd_ch) {
-        case 0: return symbol_create(mol,OXY);
-        case 'G': return symbol_create(mol,118);
-        case 'S': return symbol_create(mol,76);
-      }
-      break;
 
-    case 'P':
-      switch (snd_ch) {
-        case 0: return symbol_create(mol,PHO);
-        case 'A': return symbol_create(mol,91);
-        case 'B': return symbol_create(mol,82);
-        case 'D': return symbol_create(mol,46);
-        case 'M': return symbol_create(mol,61);
-        case 'O': return symbol_create(mol,84);
-        case 'R': return symbol_create(mol,59);
-        case 'T': return symbol_create(mol,78);
-        case 'U': return symbol_create(mol,94);
-      }
-      break;
-    
-    case 'Q':
-      switch (snd_ch) {
-        case 0: return symbol_create(mol,OXY);
-      }
-      break; 
+/* makes a symbol on the open edge */
+template <bool BUILD>
+static symbol_t* walk_symbol(graph_t *mol, edge_t *edge, uint16_t atomic_num)
+{
+  if (!BUILD) {
+    wln_nsymbols++;
+    return TOKEN_SYMBOL;
+  }
+  symbol_t *s = symbol_create(mol, atomic_num);
+  edge_bond(mol, edge, s);
+  return s;
+}
 
-    case 'R':
-      switch (snd_ch) {
-        case 'A': return symbol_create(mol,88);
-        case 'B': return symbol_create(mol,37);
-        case 'E': return symbol_create(mol,75);
-        case 'F': return symbol_create(mol,104);
-        case 'G': return symbol_create(mol,111);
-        case 'H': return symbol_create(mol,45);
-        case 'N': return symbol_create(mol,86);
-        case 'U': return symbol_create(mol,44);
-      }
-      break;
 
-    case 'S':
-      switch (snd_ch) {
-        case 0:  return symbol_create(mol,SUL);
-        case 'B': return symbol_create(mol,51);
-        case 'C': return symbol_create(mol,21);
-        case 'E': return symbol_create(mol,34);
-        case 'G': return symbol_create(mol,106);
-        case 'I': return symbol_create(mol,14);
-        case 'M': return symbol_create(mol,62);
-        case 'N': return symbol_create(mol,50);
-        case 'R': return symbol_create(mol,38);
-      }
-      break;
+template <bool BUILD>
+static edge_t* walk_edge(graph_t *mol, symbol_t *parent)
+{
+  return BUILD ? edge_create(mol, parent) : TOKEN_EDGE;
+}
 
-    case 'T':
-      switch (snd_ch) {
-        case 'A': return symbol_create(mol,73);
-        case 'B': return symbol_create(mol,65);
-        case 'C': return symbol_create(mol,43);
-        case 'E': return symbol_create(mol,52);
-        case 'H': return symbol_create(mol,90);
-        case 'I': return symbol_create(mol,22);
-        case 'L': return symbol_create(mol,81);
-        case 'M': return symbol_create(mol,69);
-        case 'S': return symbol_create(mol,117);
-      }
-      break;
 
-    case 'U':
-      switch (snd_ch) {
-        case 'R': return symbol_create(mol,92);
-      }
-      break;
+static symbol_t* symbol_change(symbol_t *s, uint16_t atomic_num)
+{
+  symbol_set_num(s, atomic_num);
+  return s; 
+}
 
-    case 'V':
-      switch (snd_ch) {
-        case 'A': return symbol_create(mol,23);
-      }
-      break;
-  
-    case 'W':
-      switch (snd_ch) {
-        case 'T': return symbol_create(mol,74);
-      }
-      break; 
 
-    case 'X':
-      switch (snd_ch) {
-        case 'E': return symbol_create(mol,54);
-      }
-      break;
+/* reads the element code of a dash symbol, zero if the code is invalid */
+static uint16_t dash_element(char **wln)
+{
+  char *ptr = *wln;
+  unsigned char fst_ch = *ptr++;
+  if (!fst_ch)
+    return 0;
+  unsigned char snd_ch = *ptr++; // this could be null (C-string safe)
 
-    case 'Y':
-      switch (snd_ch) {
-        case 'T': return symbol_create(mol,39);
-        case 'B': return symbol_create(mol,70);
-      }
-      break;
+  if (snd_ch && *ptr != '-')
+    return 0;
+  else
+    *wln = snd_ch ? ++ptr : ptr-1; // never step past the terminator
 
-    case 'Z':
-      switch (snd_ch) {
-        case 'N': return symbol_create(mol,30);
-        case 'R': return symbol_create(mol,30);
-      }
-      break;
-  }
-  return NULL; 
+  return wln_element_number(fst_ch, snd_ch);
 }
 
 
@@ -434,10 +294,7 @@ graph_add_hydrogens(graph_t *mol)
     if (symbol_get_charge(s) == 0 && symbol_get_hydrogens(s) == 0) {
       switch (symbol_get_num(s)) {
         case CAR: symbol_safeset_hydrogens(s, 4 - modifier); break;
-        case NIT: 
-            fprintf(stderr, "%d\n", modifier); 
-            symbol_safeset_hydrogens(s, 3 - modifier); 
-            break;
+        case NIT: symbol_safeset_hydrogens(s, 3 - modifier); break;
         case OXY: symbol_safeset_hydrogens(s, 2 - modifier); break;
 
         case SUL: 
@@ -465,7 +322,7 @@ static edge_t* edge_create(graph_t *mol, symbol_t *curr, symbol_t *prev)
   edge_t *bptr = (edge_t*)0;
 #ifdef USING_OPENBABEL
   if (!mol->AddBond(curr->GetIdx(), prev->GetIdx(), 1)) {
-    fprintf(stderr, "Error: failed to make bond betweens atoms %d --> %d\n", curr->GetIdx(),prev->GetIdx());
+    wln_error(WLN_ERR_SYMBOL, "failed to make bond betweens atoms %d --> %d\n", curr->GetIdx(),prev->GetIdx());
     return bptr;
   }
   else 
@@ -535,25 +392,42 @@ struct wlnpath {
 }; 
 
 
-static bool ring_fill(graph_t *mol, struct wlnpath *ring, unsigned int size) 
+/* the path must fit the locant masks, a validating walk only takes its size */
+template <bool BUILD>
+static int ring_fill(graph_t *mol, struct wlnpath *ring, int size)
 {
+  if (size < 1 || size > (int)WLN_MAX)
+    return wln_error(WLN_ERR_RING, "ring path of %d atoms is out of range\n", size);
+
+  if (!BUILD) {
+    ring->size = size;
+    wln_nsymbols += size;
+    return WLN_OK;
+  }
+
   ring->path[0].s = symbol_create(mol, CAR);
   for (uint16_t i = 1; i < size; i++) {
     struct wlnlocant *curr = &ring->path[i];
     struct wlnlocant *prev = &ring->path[i-1];
     curr->s = symbol_create(mol, CAR);
     if (!edge_create(mol, curr->s, prev->s)) 
-      return false;
+      return WLN_ERROR; 
   }
   ring->size = size; 
-  return true; 
+  return WLN_OK; 
 }
 
 
+template <bool BUILD>
 static bool ring_fill_benzene(graph_t *mol, struct wlnpath *ring) 
 {
-  ring->path[0].s = symbol_create(mol, CAR);
   ring->size = 6; 
+  if (!BUILD) {
+    wln_nsymbols += 6; 
+    return true; 
+  }
+
+  ring->path[0].s = symbol_create(mol, CAR);
 
   for (unsigned int i=1; i<6; i++) {
     struct wlnlocant *curr = &ring->path[i];
@@ -587,10 +461,11 @@ static bool ring_fill_benzene(graph_t *mol, struct wlnpath *ring)
  * The path is maximised at each step which mirrors the minimisation
  * of the fusion sum as mentioned in the manuals. 
 */
-static bool pathsolverIII_fast(graph_t *mol, 
-                               struct wlnpath *r, 
-                               struct wlnsubcycle *SSSR, 
-                               uint8_t nSSSR)
+template <bool BUILD>
+static int pathsolverIII_fast(graph_t *mol, 
+                              struct wlnpath *r, 
+                              struct wlnsubcycle *SSSR, 
+                              uint8_t nSSSR)
 {
   uint8_t last_idx = r->size-1; 
   struct pathmapping {
@@ -601,11 +476,11 @@ static bool pathsolverIII_fast(graph_t *mol,
   uint64_t bridge_mask = r->bridge_mask; 
 
   for (uint16_t i = 1; i < r->size; i++) {
-    path[i].nlocants = (bridge_mask & (1 << i)) ? 0:1; 
+    path[i].nlocants = (bridge_mask & (1ULL << i)) ? 0:1; 
     path[i-1].nxt_locant = i;
   }
   path[0].nlocants = (bridge_mask & 1) ? 1:2; 
-  path[last_idx].nlocants = (bridge_mask & (1 << last_idx)) ? 1:2; 
+  path[last_idx].nlocants = (bridge_mask & (1ULL << last_idx)) ? 1:2; 
   path[last_idx].nxt_locant = last_idx;
 
   uint8_t steps, start, end;
@@ -620,33 +495,49 @@ static bool pathsolverIII_fast(graph_t *mol,
     end      = start; 
     
     // if used max times in ring, shift along path
-    while (path[start].nlocants == 0 && start < r->size) {
+    while (start < r->size && path[start].nlocants == 0) {
       start++;
       steps--; 
     }
 
+    /* a subcycle that runs off the path is left unbonded, the walk is on 
+     * the locant indices alone so a validating walk stops in the same place */
+    if (start == r->size) {
+      wln_warning("subcycle runs off the ring path\n"); 
+      return WLN_OK; 
+    }
+
     for (uint16_t s = 0; s < steps-1; s++) {
       unsigned char nxt = path[end].nxt_locant; 
-      symbol_set_aromatic(r->path[end].s, arom);
-      edge_t *e = graph_get_edge(mol, r->path[end].s, r->path[nxt].s);
-      if (!e) {
-        fprintf(stderr, "Error: edge fetch failure in path solver\n"); 
-        return false; 
+      if (BUILD)
+        symbol_set_aromatic(r->path[end].s, arom);
+      if (nxt == end) {
+        wln_warning("subcycle runs off the ring path\n"); 
+        return WLN_OK; 
+      }
+      if (BUILD) {
+        edge_t *e = graph_get_edge(mol, r->path[end].s, r->path[nxt].s);
+        edge_set_aromatic(e, arom);
       }
-      edge_set_aromatic(e, arom);
       end = nxt; 
     }
-    symbol_set_aromatic(r->path[end].s, arom);
 
 //    fprintf(stderr,"%d: %c --> %c (%d)\n",steps, start + 'A', end + 'A', subcycle->aromatic); 
     
     path[start].nlocants--;
     path[start].nxt_locant = end;
 
-    edge_t *cross = edge_create(mol, r->path[start].s, r->path[end].s);
-    edge_set_aromatic(cross, arom);
+    if (BUILD) {
+      symbol_set_aromatic(r->path[end].s, arom);
+      if (end != start) {
+        edge_t *cross = edge_create(mol, r->path[start].s, r->path[end].s);
+        if (!cross)
+          return WLN_ERROR; 
+        edge_set_aromatic(cross, arom);
+      }
+    }
   }
-  return true; 
+  return WLN_OK; 
 }
 
 
@@ -775,18 +666,17 @@ static void pathsolverIII(graph_t *mol,
 }
 
 
-static symbol_t* parse_opening_terminator(graph_t *mol, unsigned char ch) {
-  symbol_t *curr_symbol = NULL; 
+/* element of a terminator that opens a component, zero if ch is not one */
+static uint16_t opening_terminator(unsigned char ch) {
   switch (ch) {
-    case 'E': curr_symbol = symbol_create(mol, BRO); break; 
-    case 'F': curr_symbol = symbol_create(mol, FLU); break; 
-    case 'G': curr_symbol = symbol_create(mol, CHL); break; 
-    case 'I': curr_symbol = symbol_create(mol, IOD); break; 
-    case 'Q': curr_symbol = symbol_create(mol, OXY); break; 
-    case 'Z': curr_symbol = symbol_create(mol, NIT); break; 
-    default: return NULL; 
+    case 'E': return BRO; 
+    case 'F': return FLU; 
+    case 'G': return CHL; 
+    case 'I': return IOD; 
+    case 'Q': return OXY; 
+    case 'Z': return NIT; 
+    default: return 0; 
   } 
-  return curr_symbol;
 }
 
 
@@ -810,8 +700,35 @@ static int parse_locant()
 }
 
 
-/* this expects the symbol after the opening L|T */
-static int cyclic_recursive_parse(graph_t *mol, edge_t *inline_edge, int inline_locant) 
+/* sets the path symbol to the hetero atom its ring letter names */
+static int ring_hetero_atom(graph_t *mol, symbol_t *s, unsigned char ch)
+{
+  switch (ch) {
+    case 'B': symbol_change(s, BOR); break;
+
+    case 'K':
+      symbol_change(s, NIT);
+      symbol_set_charge(s, +1);
+      break;
+
+    case 'N': symbol_change(s, NIT); break;
+    case 'M': symbol_change(s, NIT); break;
+    case 'O': symbol_change(s, OXY); break;
+    case 'P': symbol_change(s, PHO); break;
+    case 'S': symbol_change(s, SUL); break;
+    case 'V': return add_oxy(mol, s); 
+  }
+  return WLN_OK; 
+}
+
+
+/* 
+ * this expects the symbol after the opening L|T, fills ring from the block. 
+ * Every locant is range checked against the path before it is used, so a 
+ * validating walk rejects exactly what a read would.
+ */
+template <bool BUILD>
+static int cyclic_block_parse(graph_t *mol, struct wlnpath *ring, edge_t *inline_edge, int inline_locant) 
 {
   bool seen_pseudo = false; 
   edge_t *edge; 
@@ -823,9 +740,6 @@ static int cyclic_recursive_parse(graph_t *mol, edge_t *inline_edge, int inline_
   struct wlnsubcycle SSSR[WLN_MAX]; 
   uint8_t assignments = 0; 
 
-  struct wlnpath ring;
-  memset(&ring, 0, sizeof(struct wlnpath)); 
-  
   unsigned char ch;   
   while (*wln_ptr) {
     ch = *wln_ptr++; 
@@ -840,6 +754,8 @@ ring_parse_sssr:
       case '7':
       case '8':
       case '9':
+        if (nSSSR == WLN_MAX)
+          return wln_error(WLN_ERR_RING, "more than %d rings in wln ring\n", (int)WLN_MAX); 
         max_path_size += (ch - '0') - (2 * (max_path_size > 0)); 
         SSSR[nSSSR].size      = ch - '0'; 
         SSSR[nSSSR].aromatic  = true; // default is aromatic 
@@ -855,17 +771,22 @@ ring_parse_sssr:
         }
         else if (*wln_ptr >= '1' && *wln_ptr <= '9')
           goto ring_parse_multi;
-        else 
-          return WLN_ERROR; 
+        else {
+          if (*wln_ptr)
+            wln_ptr++; 
+          return wln_error(WLN_ERR_LOCANT, "ring space must open a locant or multicyclic block\n"); 
+        }
         break; 
 
       case '&':
       case 'T': 
-        ring_fill(mol, &ring, max_path_size); 
+        if (ring_fill<BUILD>(mol, ring, max_path_size) != WLN_OK)
+          return WLN_ERROR; 
         goto ring_parse_arom;
 
       case 'J': 
-        ring_fill(mol, &ring, max_path_size); 
+        if (ring_fill<BUILD>(mol, ring, max_path_size) != WLN_OK)
+          return WLN_ERROR; 
         goto ring_parse_end;
 
       case 'B':
@@ -882,10 +803,11 @@ ring_parse_sssr:
       case 'G':
       case 'I':
       case 'Q':
-        ring_fill(mol, &ring, max_path_size); 
+        if (ring_fill<BUILD>(mol, ring, max_path_size) != WLN_OK)
+          return WLN_ERROR; 
         goto ring_parse_hetero;
 
-      default: return wln_error("invalid character in ring parse - %c\n", ch); 
+      default: return wln_error(WLN_ERR_CHARACTER, "invalid character in ring parse - %c\n", ch); 
     }
   }
 
@@ -905,26 +827,23 @@ fst_locant_jmp:
 
     // bridge logic, locant ch must of been a bridging atom
     case 'T':
-      max_path_size--; 
-      ring_fill(mol, &ring, max_path_size); 
-      if (locant_ch >= ring.size)
-        return wln_error("bridge-atom assignment out of bounds - %c\n", locant_ch + 'A');
-      ring.bridge_mask |= (1 << locant_ch); 
-      locant_ch = 0; 
-      goto ring_parse_arom;
-
     case 'J': 
       max_path_size--; 
-      ring_fill(mol, &ring, max_path_size); 
-      if (locant_ch >= ring.size)
-        return wln_error("bridge-atom assignment out of bounds - %c\n", locant_ch + 'A');
-      ring.bridge_mask |= (1 << locant_ch); 
+      if (ring_fill<BUILD>(mol, ring, max_path_size) != WLN_OK)
+        return WLN_ERROR; 
+      if (locant_ch >= ring->size)
+        return wln_error(WLN_ERR_LOCANT, "bridge-atom assignment out of bounds - %c\n", locant_ch + 'A');
+      ring->bridge_mask |= (1ULL << locant_ch); 
       locant_ch = 0; 
-      goto ring_parse_end;
+      if (ch == 'J')
+        goto ring_parse_end; 
+      goto ring_parse_arom;
 
     case ' ':
+      if (locant_ch >= (int)WLN_MAX)
+        return wln_error(WLN_ERR_LOCANT, "bridge-atom assignment out of bounds - %c\n", locant_ch + 'A');
       max_path_size--; 
-      ring.bridge_mask |= (1 << locant_ch); 
+      ring->bridge_mask |= (1ULL << locant_ch); 
       locant_ch = 0; 
       goto ring_parse_sssr;
 
@@ -942,23 +861,26 @@ fst_locant_jmp:
     case 'G':
     case 'I':
     case 'Q':
-      ring_fill(mol, &ring, max_path_size); 
+      if (ring_fill<BUILD>(mol, ring, max_path_size) != WLN_OK)
+        return WLN_ERROR; 
       goto ring_parse_hetero;
 
-    default: return wln_error("invalid character in ring parse - %c\n", ch); 
+    default: return wln_error(WLN_ERR_CHARACTER, "invalid character in ring parse - %c\n", ch); 
   }
 
 ring_parse_multi:
-  ch = *wln_ptr; 
-  wln_ptr += (ch - '0') + 1; // skip the multi-block
-  if (*wln_ptr != ' ')
-    return wln_error("invalid notation for ring multi block\n"); 
+  /* skip the multi-block, which must end inside the string */
+  for (ch = *wln_ptr - '0' + 1; ch && *wln_ptr; ch--)
+    wln_ptr++; 
+  if (ch || *wln_ptr != ' ')
+    return wln_error(WLN_ERR_RING, "invalid notation for ring multi block\n"); 
   wln_ptr++; 
   max_path_size = parse_locant(); 
   if (max_path_size == WLN_ERROR)
     return WLN_ERROR; 
   
-  ring_fill(mol, &ring, max_path_size+1); 
+  if (ring_fill<BUILD>(mol, ring, max_path_size+1) != WLN_OK)
+    return WLN_ERROR; 
   ch = *wln_ptr; 
   switch (ch) {
       case 'J': wln_ptr++ ; goto ring_parse_end;
@@ -983,7 +905,7 @@ ring_parse_multi:
       case 'Q':
         ch = *wln_ptr++; 
         goto ring_parse_hetero; 
-      default: return wln_error("invalid character in ring parse - %c\n", ch); 
+      default: return wln_error(WLN_ERR_CHARACTER, "invalid character in ring parse - %c\n", ch); 
   }
 
   while (*wln_ptr) {
@@ -994,36 +916,41 @@ ring_parse_hetero:
         if (*wln_ptr >= 'A' && *wln_ptr <= 'Z') {
           if ((locant_ch = parse_locant()) == WLN_ERROR)
             return WLN_ERROR; 
-          if (locant_ch >= ring.size)
-            return wln_error("hetero-atom assignment out of bounds - %c\n", locant_ch + 'A');
+          if (locant_ch >= ring->size)
+            return wln_error(WLN_ERR_LOCANT, "hetero-atom assignment out of bounds - %c\n", locant_ch + 'A');
+        }
+        else {
+          if (*wln_ptr)
+            wln_ptr++; 
+          return wln_error(WLN_ERR_LOCANT, "hetero-atom space must open a locant\n"); 
         }
-        else 
-          return WLN_ERROR; 
 
       case 'H': break;
-      case 'B': symbol_change(ring.path[locant_ch++].s, BOR); break;
 
+      case 'B':
       case 'K':
-        symbol_change(ring.path[locant_ch].s, NIT);
-        symbol_set_charge(ring.path[locant_ch++].s, +1);
-        break;
-
-      case 'N': symbol_change(ring.path[locant_ch++].s, NIT); break;
-      case 'M': symbol_change(ring.path[locant_ch++].s, NIT); break;
-      case 'O': symbol_change(ring.path[locant_ch++].s, OXY); break;
-      case 'P': symbol_change(ring.path[locant_ch++].s, PHO); break;
-      case 'S': symbol_change(ring.path[locant_ch++].s, SUL); break;
-      case 'V': 
-        if (add_oxy(mol, ring.path[locant_ch++].s) != WLN_OK) 
+      case 'N':
+      case 'M':
+      case 'O':
+      case 'P':
+      case 'S':
+      case 'V':
+        /* hetero atoms step along the path, and must stay on it */
+        if (locant_ch >= ring->size)
+          return wln_error(WLN_ERR_LOCANT, "hetero-atom assignment out of bounds - %c\n", locant_ch + 'A');
+        if (BUILD && ring_hetero_atom(mol, ring->path[locant_ch].s, ch) != WLN_OK) 
           return WLN_ERROR; 
-        else break; 
+        locant_ch++; 
+        break; 
       
       case 'U':
-        if (locant_ch >= ring.size - 1) 
-          return wln_error("could not unsaturate bond due - locant out of bounds\n");
-        edge = graph_get_edge(mol, ring.path[locant_ch].s, 
-                              ring.path[locant_ch+1].s);
-        edge_unsaturate(edge);
+        if (locant_ch >= ring->size - 1) 
+          return wln_error(WLN_ERR_LOCANT, "could not unsaturate bond due - locant out of bounds\n");
+        if (BUILD) {
+          edge = graph_get_edge(mol, ring->path[locant_ch].s, 
+                                ring->path[locant_ch+1].s);
+          edge_unsaturate(edge);
+        }
         break;
 
       case 'X':
@@ -1033,7 +960,7 @@ ring_parse_hetero:
       case '&': goto ring_parse_arom;
       case 'T': goto ring_parse_arom;
       case 'J': goto ring_parse_end;
-      default: return wln_error("invalid character in ring parse - %c\n", ch); 
+      default: return wln_error(WLN_ERR_CHARACTER, "invalid character in ring parse - %c\n", ch); 
     }
   }
 
@@ -1043,13 +970,13 @@ ring_parse_arom:
     switch (ch) {
       case '&':
         if (assignments == nSSSR) 
-          return wln_error("too many aromaticity assignments for wln ring\n");
+          return wln_error(WLN_ERR_RING, "too many aromaticity assignments for wln ring\n");
         SSSR[assignments++].aromatic = true;  
         break; 
 
       case 'T':
         if (assignments == nSSSR) 
-          return wln_error("too many aromaticity assignments for wln ring\n");
+          return wln_error(WLN_ERR_RING, "too many aromaticity assignments for wln ring\n");
         SSSR[assignments++].aromatic = false;  
         break; 
 
@@ -1059,112 +986,210 @@ ring_parse_arom:
             SSSR[i].aromatic = false;
         }
         else if (assignments != nSSSR) 
-          return wln_error("not enough aromaticity assignments for wln ring\n");
+          return wln_error(WLN_ERR_RING, "not enough aromaticity assignments for wln ring\n");
         goto ring_parse_end; 
 
-      default: return wln_error("invalid character in ring parse - %c\n", ch); 
+      default: return wln_error(WLN_ERR_CHARACTER, "invalid character in ring parse - %c\n", ch); 
     }
   }
 
 ring_parse_end:
-  if (seen_pseudo)
-    pathsolverIII(mol, &ring, SSSR, nSSSR);  
-  else
-    pathsolverIII_fast(mol, &ring, SSSR, nSSSR);  
+  for (unsigned int i=0; i < nSSSR; i++) {
+    if (SSSR[i].locant >= ring->size)
+      return wln_error(WLN_ERR_LOCANT, "subcycle locant out of range of ring - %c\n", SSSR[i].locant + 'A'); 
+  }
 
-  if (inline_edge) {
-    if (inline_locant >= max_path_size)
-      return wln_error("inline locant out of bounds for ring\n"); 
-    symbol_t *inline_atom = ring.path[inline_locant].s;
-    edge_bond(mol, inline_edge, inline_atom); 
+  if (seen_pseudo) {
+    if (BUILD)
+      pathsolverIII(mol, ring, SSSR, nSSSR);  
   }
+  else if (pathsolverIII_fast<BUILD>(mol, ring, SSSR, nSSSR) != WLN_OK)
+    return WLN_ERROR; 
 
-  if (*wln_ptr == ' ') {
-    wln_ptr++; 
-    if (*wln_ptr == '&') {
-      wln_ptr++; 
-      return start_wln_parse(mol); 
-    }
-    else if (parse_ring_locants(mol, &ring) != WLN_OK)
-      return WLN_ERROR; 
+  if (inline_edge) {
+    if (inline_locant >= ring->size)
+      return wln_error(WLN_ERR_LOCANT, "inline locant out of bounds for ring\n"); 
+    if (BUILD)
+      edge_bond(mol, inline_edge, ring->path[inline_locant].s); 
   }
 
   return WLN_OK; 
 }
 
 
-/* this expects the entry character to be the character after the locant space */
-static int parse_ring_locants(graph_t *mol, struct wlnpath *ring)
-{
-  unsigned char ch = *wln_ptr; 
-  if (!*wln_ptr)
-    return WLN_ERROR;
+/*
+ * Frames of the explicit parse stack, each is the continuation of what used 
+ * to be a recursive call:
+ *
+ *  FRAME_START   - a molecule component, holds the dummy start symbol
+ *  FRAME_ARMS    - a branching symbol with arms left to parse
+ *  FRAME_LOCANTS - a ring whose locant branches are being parsed
+ *  FRAME_RESUME  - a chain waiting for its inline ring to finish
+ */
+#define FRAME_START   0
+#define FRAME_ARMS    1
+#define FRAME_LOCANTS 2
+#define FRAME_RESUME  3
+
+struct wlnframe {
+  uint8_t type; 
+  uint8_t arms;       /* arms left to parse */
+  bool methyl;        /* open arms are closed with a methyl */
+  bool dioxo;         /* component started with W */
+  bool owned;         /* ring is released when the frame pops */
+  symbol_t *symbol; 
+  edge_t *edge; 
+  struct wlnpath *ring; 
+};
 
-  while (*wln_ptr) {
-    if (*wln_ptr == '&') {
-      wln_ptr++; 
-      return start_wln_parse(mol); 
-    }
+/* parse stack and ring pool live for the thread, grown as needed */
+static thread_local struct wlnframe *wln_stack; 
+static thread_local unsigned int wln_stack_size; 
+static thread_local unsigned int wln_stack_alloc; 
 
-    int locant = parse_locant(); 
+static thread_local struct wlnpath **ring_pool; 
+static thread_local unsigned int ring_pool_size; 
+static thread_local unsigned int ring_pool_alloc; 
 
-    if (locant == WLN_ERROR) 
-      return wln_error("failed to parse locant\n");  
-    if (locant >= ring->size) 
-      return wln_error("locant out of range of ring\n"); 
-  
-    symbol_t *curr_symbol = ring->path[locant].s; 
-    edge_t *curr_edge = edge_create(mol, curr_symbol); 
 
-    switch (ch) {
-      case '-':
-        /* inline ring definition */
-        break; 
-      
-      default:
-        if (branch_recursive_parse(mol, curr_symbol, curr_edge, ring) == WLN_ERROR)
-          return WLN_ERROR; 
-        if (!edge_get_end(curr_edge)) {
-          symbol_t *methyl = symbol_create(mol, CAR);
-          edge_bond(mol, curr_edge, methyl);  
-        }
+static struct wlnframe* frame_push(uint8_t type)
+{
+  if (wln_stack_size == wln_stack_alloc) {
+    wln_stack_alloc = wln_stack_alloc ? wln_stack_alloc * 2 : 64; 
+    wln_stack = (struct wlnframe*)realloc(wln_stack, wln_stack_alloc*sizeof(struct wlnframe)); 
+  }
+  struct wlnframe *frame = &wln_stack[wln_stack_size++]; 
+  memset(frame, 0, sizeof(struct wlnframe)); 
+  frame->type = type; 
+  return frame; 
+}
 
-        if (*wln_ptr == '&') {
-          /* move out of the current ring */
-          wln_ptr++; 
-          return WLN_OK; 
-        }
 
-        /* move to the next locant */
-        if (*wln_ptr == ' ') {
-          wln_ptr++; 
-          if (*wln_ptr == '&') {
-            wln_ptr++; 
-            return start_wln_parse(mol); 
-          }
-        }
-        break; 
-    }
-  }
+static struct wlnpath* ring_alloc()
+{
+  struct wlnpath *ring; 
+  if (ring_pool_size)
+    ring = ring_pool[--ring_pool_size]; 
+  else 
+    ring = (struct wlnpath*)malloc(sizeof(struct wlnpath)); 
+  /* the path is written by ring_fill up to size, nothing past it is read */
+  ring->bridge_mask = 0; 
+  ring->size = 0; 
+  return ring; 
+}
 
-  return WLN_OK; 
+
+static void ring_release(struct wlnpath *ring)
+{
+  if (ring_pool_size == ring_pool_alloc) {
+    ring_pool_alloc = ring_pool_alloc ? ring_pool_alloc * 2 : 8; 
+    ring_pool = (struct wlnpath**)realloc(ring_pool, ring_pool_alloc*sizeof(struct wlnpath*)); 
+  }
+  ring_pool[ring_pool_size++] = ring; 
 }
 
 
-static int branch_recursive_parse(graph_t *mol, symbol_t *symbol, edge_t *edge, struct wlnpath *ring)
+static void frame_pop()
 {
-  int ret; 
-  unsigned char ch = *wln_ptr; 
-  edge_t *curr_edge = edge;
-  symbol_t *curr_symbol = symbol;
-  symbol_t *prev_symbol;  
-  struct wlnpath *benzene; 
-  uint16_t counter   = 0; 
+  struct wlnframe *frame = &wln_stack[--wln_stack_size]; 
+  if (frame->owned)
+    ring_release(frame->ring); 
+}
 
-  if (!*wln_ptr)
-    return WLN_OK;
 
-  while (*wln_ptr) {
+/* hand back the thread's parse stacks and ring pool, for exiting threads */
+static void parse_stack_free()
+{
+  for (unsigned int i=0; i<ring_pool_size; i++)
+    free(ring_pool[i]); 
+  free(ring_pool); 
+  free(wln_stack); 
+  ring_pool = NULL; 
+  wln_stack = NULL; 
+  ring_pool_size = ring_pool_alloc = 0; 
+  wln_stack_size = wln_stack_alloc = 0; 
+}
+
+
+/* 
+ * Iterative WLN walker, chains and branches are read in a loop and every 
+ * point that would recurse pushes a frame instead. When a chain closes the 
+ * top frame is resumed, so notation depth is bounded by the heap and not
+ * the thread stack. uses goto to keep logic clean, nothing to be scared of. 
+ * With BUILD false the same walk validates, mol is unused and may be NULL. 
+ */
+template <bool CYCLIC, bool BUILD>
+static int start_wln_parse(graph_t *mol)
+{
+  struct wlnframe *frame; 
+  symbol_t *curr_symbol; 
+  symbol_t *prev_symbol; 
+  symbol_t *init_symbol; 
+  symbol_t *open_term; 
+  edge_t *curr_edge; 
+  edge_t *init_edge; 
+  edge_t *inline_edge; 
+  struct wlnpath *ring; 
+  struct wlnpath *benzene; 
+  int locant; 
+  unsigned int counter; 
+  uint16_t atomic_num; 
+  unsigned char ch; 
+
+  wln_stack_size = 0; 
+  wln_nsymbols = 0; 
+
+  // init conditions, make one dummy atom, and one bond - work of the virtual bond
+  // idea entirely *--> grow..., delete at the end to save branches
+component_start:
+  if (BUILD) {
+    init_symbol = symbol_create(mol, DUM); 
+    init_edge = graph_new_edge(mol); 
+    edge_set_begin(init_edge, init_symbol); 
+  }
+  else {
+    init_symbol = TOKEN_SYMBOL; 
+    init_edge = TOKEN_DUMMY_EDGE; 
+  }
+
+  atomic_num = opening_terminator(*wln_ptr);
+  if (atomic_num) {
+    open_term = walk_symbol<BUILD>(mol, init_edge, atomic_num); 
+    init_edge = walk_edge<BUILD>(mol, open_term); 
+    wln_ptr++; 
+    if (*wln_ptr == 'H') {
+      if (BUILD)
+        symbol_incr_hydrogens(open_term);  
+      wln_ptr++; 
+    }
+  }
+
+  frame = frame_push(FRAME_START); 
+  frame->symbol = init_symbol; 
+  frame->edge   = init_edge; 
+
+  if (*wln_ptr == 'W') {
+    wln_ptr++; 
+    frame->dioxo = true; 
+  }
+
+  if (CYCLIC && (*wln_ptr == 'L' || *wln_ptr == 'T')) {
+    wln_ptr++; 
+    inline_edge = NULL; 
+    locant = 0; 
+    goto ring_block; 
+  }
+
+  curr_symbol = NULL; 
+  curr_edge = init_edge; 
+  ring = NULL; 
+
+branch_start:
+  if (!*wln_ptr)
+    goto chain_close; 
+
+branch_loop:
+  while (*wln_ptr) {
     ch  = *wln_ptr++;
     switch (ch) {
       case '0':
@@ -1179,52 +1204,59 @@ static int branch_recursive_parse(graph_t *mol, symbol_t *symbol, edge_t *edge,
       case '9':
         counter = ch - '0';
         while ((ch = *wln_ptr) && ch >= '0' && ch <= '9') {
-          counter *= 10; 
-          counter += ch - '0'; 
+          if (counter <= WLN_CHAIN_MAX)
+            counter = counter * 10 + (ch - '0'); 
           wln_ptr++;
         }
-        for (uint16_t i=0; i<counter; i++) {
-          symbol_t *carbon = symbol_create(mol, CAR);
-          edge_bond(mol, curr_edge, carbon); 
-          curr_edge = edge_create(mol, carbon); 
-          curr_symbol = carbon; 
+        if (counter > WLN_CHAIN_MAX) {
+          wln_error(WLN_ERR_UNSUPPORTED, "carbon chain longer than %d atoms\n", WLN_CHAIN_MAX); 
+          goto parse_error; 
+        }
+        if (!counter)
+          break; 
+        if (BUILD)
+          curr_edge = chain_create(mol, curr_edge, counter, &curr_symbol); 
+        else {
+          wln_nsymbols += counter; 
+          curr_symbol = TOKEN_SYMBOL; 
+          curr_edge = TOKEN_EDGE; 
         }
         break;
       
       case 'A':
       case 'J':
-        return wln_error("non-atomic symbol used in chain"); 
+        wln_error(WLN_ERR_SYMBOL, "non-atomic symbol used in chain"); 
+        goto parse_error; 
       
       case 'B':
-        curr_symbol = symbol_create(mol, BOR);
-        edge_bond(mol, curr_edge, curr_symbol); 
-
-        for (unsigned int i=0; i<2; i++) {
-          curr_edge = edge_create(mol, curr_symbol); 
-          ret = branch_recursive_parse(mol, curr_symbol, curr_edge, ring); 
-          if (ret == WLN_ERROR)
-            return ret; 
-          if (!*wln_ptr)
-            break; 
-        }
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, BOR); 
+        frame = frame_push(FRAME_ARMS); 
+        frame->arms = 2; 
+        goto arm_push; 
       
       case 'C':
         /* check the edge, if we can triple bond backwards, within chemical rules.
          * Then do. If we can only double bond, take that forcing next bond to be double. 
          * Otherwise single bond and force the next edge to be triple. */
+        if (BUILD ? symbol_get_num(edge_get_beg(curr_edge)) == DUM : curr_edge == TOKEN_DUMMY_EDGE) {
+          wln_error(WLN_ERR_SYMBOL, "WLN symbol requires a prefix symbol\n"); 
+          goto parse_error; 
+        }
+        if (!BUILD) {
+          curr_symbol = walk_symbol<BUILD>(mol, curr_edge, CAR); 
+          curr_edge = walk_edge<BUILD>(mol, curr_symbol); 
+          break; 
+        }
+
         curr_symbol = symbol_create(mol, CAR);
         prev_symbol = edge_get_beg(curr_edge); 
         switch (symbol_get_num(prev_symbol)) {
-          case DUM: 
-            return wln_error("WLN symbol requires a prefix symbol\n"); 
-
           case NIT:
             /* triple bond */
             if (symbol_get_valence(prev_symbol) == 0) {
               edge_set_order(curr_edge, 3); 
               edge_bond(mol, curr_edge, curr_symbol); 
-              curr_edge = edge_create(mol, curr_symbol); 
+              curr_edge = walk_edge<BUILD>(mol, curr_symbol); 
               break; 
             }
 
@@ -1232,7 +1264,7 @@ static int branch_recursive_parse(graph_t *mol, symbol_t *symbol, edge_t *edge,
             /* X=C=X default behavior */
             edge_set_order(curr_edge, 2); 
             edge_bond(mol, curr_edge, curr_symbol); 
-            curr_edge = edge_create(mol, curr_symbol); 
+            curr_edge = walk_edge<BUILD>(mol, curr_symbol); 
             edge_set_order(curr_edge, 2); 
             break; 
         }
@@ -1240,331 +1272,651 @@ static int branch_recursive_parse(graph_t *mol, symbol_t *symbol, edge_t *edge,
 
       // extrememly rare open chelate notation
       case 'D':
-        return wln_error("WLN symbol D (chelate) currently unhandled\n"); 
+        wln_error(WLN_ERR_UNSUPPORTED, "WLN symbol D (chelate) currently unhandled\n"); 
+        goto parse_error; 
       
       // terminator symbol 
       case 'E':
-        curr_symbol = symbol_create(mol, BRO);
-        edge_bond(mol, curr_edge, curr_symbol); 
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, BRO); 
+        goto chain_close; 
 
       case 'F':
-        curr_symbol = symbol_create(mol, FLU);
-        edge_bond(mol, curr_edge, curr_symbol); 
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, FLU); 
+        goto chain_close; 
 
       case 'G':
-        curr_symbol = symbol_create(mol, CHL);
-        edge_bond(mol, curr_edge, curr_symbol); 
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, CHL); 
+        goto chain_close; 
 
       case 'H':
-        if (!curr_symbol)
-          return wln_error("modifier requires active symbol\n"); 
-        symbol_incr_hydrogens(curr_symbol);  
+        if (!curr_symbol) {
+          wln_error(WLN_ERR_SYMBOL, "modifier requires active symbol\n"); 
+          goto parse_error; 
+        }
+        if (BUILD)
+          symbol_incr_hydrogens(curr_symbol);  
         break;
 
       case 'I':
-        curr_symbol = symbol_create(mol, IOD);
-        edge_bond(mol, curr_edge, curr_symbol); 
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, IOD); 
+        goto chain_close; 
      
       /* [N+](R)(R)(R)(R) */
       case 'K':
-        curr_symbol = symbol_create(mol, NIT);
-        edge_bond(mol, curr_edge, curr_symbol); 
-        symbol_set_charge(curr_symbol, +1); 
-
-        for (unsigned int i=0; i<3; i++) {
-          curr_edge = edge_create(mol, curr_symbol); 
-          ret = branch_recursive_parse(mol, curr_symbol, curr_edge, ring); 
-          if (ret == WLN_ERROR)
-            return ret; 
-          if (!edge_get_end(curr_edge)) {
-            symbol_t *methyl = symbol_create(mol, CAR);
-            edge_bond(mol, curr_edge, methyl);  
-          }
-        }
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, NIT); 
+        if (BUILD)
+          symbol_set_charge(curr_symbol, +1); 
+        frame = frame_push(FRAME_ARMS); 
+        frame->arms = 3; 
+        frame->methyl = true; 
+        goto arm_push; 
 
       case 'L':
       case 'T':
         /* impossible from here */
-        return wln_error("ring notation must start the molecule to be used\n");
+        wln_error(WLN_ERR_RING, "ring notation must start the molecule to be used\n");
+        goto parse_error; 
       
       /* NH(R)(R) */
       case 'M':
-        curr_symbol = symbol_create(mol, NIT); 
-        edge_bond(mol, curr_edge, curr_symbol); 
-        curr_edge = edge_create(mol, curr_symbol); 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, NIT); 
+        curr_edge = walk_edge<BUILD>(mol, curr_symbol); 
         break;
      
       /* NR(R)(R) */
       case 'N':
-        curr_symbol = symbol_create(mol, NIT);
-        edge_bond(mol, curr_edge, curr_symbol); 
-        for (unsigned int i=0; i<2; i++) {
-          curr_edge = edge_create(mol, curr_symbol); 
-          ret = branch_recursive_parse(mol, curr_symbol, curr_edge, ring); 
-          if (ret == WLN_ERROR)
-            return ret; 
-          if (!*wln_ptr)
-            break; 
-        }
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, NIT); 
+        frame = frame_push(FRAME_ARMS); 
+        frame->arms = 2; 
+        goto arm_push; 
       
       /* OR(R) */
       case 'O':
-        curr_symbol = symbol_create(mol, OXY); 
-        edge_bond(mol, curr_edge, curr_symbol); 
-        curr_edge = edge_create(mol, curr_symbol); 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, OXY); 
+        curr_edge = walk_edge<BUILD>(mol, curr_symbol); 
         break;
       
       case 'P':
-        curr_symbol = symbol_create(mol, PHO);
-        edge_bond(mol, curr_edge, curr_symbol); 
-
-        for (unsigned int i=0; i<3; i++) {
-          curr_edge = edge_create(mol, curr_symbol); 
-          ret = branch_recursive_parse(mol, curr_symbol, curr_edge, ring); 
-          if (ret == WLN_ERROR)
-            return ret; 
-          if (!*wln_ptr)
-            break; 
-        }
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, PHO); 
+        frame = frame_push(FRAME_ARMS); 
+        frame->arms = 3; 
+        goto arm_push; 
 
       case 'Q':
-        curr_symbol = symbol_create(mol, OXY);
-        edge_bond(mol, curr_edge, curr_symbol); 
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, OXY); 
+        goto chain_close; 
 
       // shorthand benzene 
       case 'R': 
-        benzene = (struct wlnpath*)malloc(sizeof(struct wlnpath)); 
-        memset(benzene, 0, sizeof(struct wlnpath)); 
-        if (!ring_fill_benzene(mol, benzene)) {
-          free(benzene); 
-          return WLN_ERROR; 
+        if (!CYCLIC) {
+          wln_error(WLN_ERR_RING, "ring notation seen in chain only parse\n"); 
+          goto parse_error; 
+        }
+        benzene = ring_alloc(); 
+        if (!ring_fill_benzene<BUILD>(mol, benzene)) {
+          ring_release(benzene); 
+          goto parse_error; 
         }
 
-        curr_symbol = benzene->path[0].s; 
-        edge_bond(mol, curr_edge, curr_symbol); 
+        if (BUILD) {
+          curr_symbol = benzene->path[0].s; 
+          edge_bond(mol, curr_edge, curr_symbol); 
+        }
+        else 
+          curr_symbol = TOKEN_SYMBOL; 
         if (*wln_ptr == ' ') {
           wln_ptr++; 
-          ret = parse_ring_locants(mol, benzene);
-          free(benzene); 
-          return ret; 
+          frame = frame_push(FRAME_LOCANTS); 
+          frame->ring  = benzene; 
+          frame->owned = true; 
+          goto locants_start; 
         }
         else {
-          curr_edge = edge_create(mol, curr_symbol); 
-          free(benzene); // ptr should be saved (unsafe code)
+          curr_edge = walk_edge<BUILD>(mol, curr_symbol); 
+          ring_release(benzene); // ptr should be saved (unsafe code)
         }
         break;
 
       case 'S':
-        curr_symbol = symbol_create(mol, SUL);
-        edge_bond(mol, curr_edge, curr_symbol); 
-
-        for (unsigned int i=0; i<3; i++) {
-          curr_edge = edge_create(mol, curr_symbol); 
-          ret = branch_recursive_parse(mol, curr_symbol, curr_edge, ring); 
-          if (ret == WLN_ERROR)
-            return ret; 
-          if (!*wln_ptr)
-            break; 
-        }
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, SUL); 
+        frame = frame_push(FRAME_ARMS); 
+        frame->arms = 3; 
+        goto arm_push; 
       
       case 'U':
-        edge_unsaturate(curr_edge); 
+        if (BUILD)
+          edge_unsaturate(curr_edge); 
         break; 
 
       case 'V':
-        curr_symbol = symbol_create(mol, CAR);
-        edge_bond(mol, curr_edge, curr_symbol); 
-        if (add_oxy(mol, curr_symbol) != WLN_OK)
-          return wln_error("failed to add =O group\n"); 
-        curr_edge = edge_create(mol, curr_symbol); 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, CAR); 
+        if (BUILD && add_oxy(mol, curr_symbol) != WLN_OK) {
+          wln_error(WLN_ERR_SYMBOL, "failed to add =O group\n"); 
+          goto parse_error; 
+        }
+        curr_edge = walk_edge<BUILD>(mol, curr_symbol); 
         break;
       
       // if not previous, create dummy carbon
       // really trying to avoid a bit state on this
       case 'W':
-        if (!curr_symbol)
-          return wln_error("modifier requires active symbol\n"); 
-        if (add_dioxo(mol, curr_symbol) != WLN_OK)
-          return wln_error("failed to add dioxo group with W\n"); 
+        if (!curr_symbol) {
+          wln_error(WLN_ERR_SYMBOL, "modifier requires active symbol\n"); 
+          goto parse_error; 
+        }
+        if (BUILD && add_dioxo(mol, curr_symbol) != WLN_OK) {
+          wln_error(WLN_ERR_SYMBOL, "failed to add dioxo group with W\n"); 
+          goto parse_error; 
+        }
         break; 
 
       case 'X':
-        curr_symbol = symbol_create(mol, CAR);
-        edge_bond(mol, curr_edge, curr_symbol); 
-
-        for (unsigned int i=0; i<3; i++) {
-          curr_edge = edge_create(mol, curr_symbol); 
-          ret = branch_recursive_parse(mol, curr_symbol, curr_edge, ring); 
-          if (ret == WLN_ERROR)
-            return ret; 
-          if (!edge_get_end(curr_edge)) {
-            symbol_t *methyl = symbol_create(mol, CAR);
-            edge_bond(mol, curr_edge, methyl);  
-          }
-        }
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, CAR); 
+        frame = frame_push(FRAME_ARMS); 
+        frame->arms = 3; 
+        frame->methyl = true; 
+        goto arm_push; 
 
       case 'Y':
-        curr_symbol = symbol_create(mol, CAR);
-        edge_bond(mol, curr_edge, curr_symbol); 
-        
-        for (unsigned int i=0; i<2; i++) {
-          curr_edge = edge_create(mol, curr_symbol); 
-          int ret = branch_recursive_parse(mol, curr_symbol, curr_edge, ring); 
-          if (ret == WLN_ERROR)
-            return ret; 
-          if (!edge_get_end(curr_edge)) {
-            symbol_t *methyl = symbol_create(mol, CAR);
-            edge_bond(mol, curr_edge, methyl);  
-          }
-        }
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, CAR); 
+        frame = frame_push(FRAME_ARMS); 
+        frame->arms = 2; 
+        frame->methyl = true; 
+        goto arm_push; 
       
       case 'Z':
-        curr_symbol = symbol_create(mol, NIT);
-        edge_bond(mol, curr_edge, curr_symbol); 
-        return WLN_OK; 
+        curr_symbol = walk_symbol<BUILD>(mol, curr_edge, NIT); 
+        goto chain_close; 
       
       case '-':
         if (*wln_ptr == ' ') {
           /* must be an inline ring */
+          if (!CYCLIC) {
+            wln_error(WLN_ERR_RING, "ring notation seen in chain only parse\n"); 
+            goto parse_error; 
+          }
           wln_ptr++; 
-          int inline_locant = parse_locant(); 
-          if (inline_locant == WLN_ERROR)
-            return wln_error("invalid notation for inline locant"); 
-          if (!(*wln_ptr == 'L' || *wln_ptr == 'T'))
-            return WLN_ERROR; 
-
+          locant = parse_locant(); 
+          if (locant == WLN_ERROR) {
+            wln_error(WLN_ERR_LOCANT, "invalid notation for inline locant"); 
+            goto parse_error; 
+          }
+          if (!(*wln_ptr == 'L' || *wln_ptr == 'T')) {
+            if (*wln_ptr)
+              wln_ptr++; 
+            wln_error(WLN_ERR_RING, "inline locant must open an L or T ring\n"); 
+            goto parse_error; 
+          }
           wln_ptr++; 
-          if (cyclic_recursive_parse(mol, curr_edge, inline_locant) != WLN_OK)
-            return WLN_ERROR; 
-          if (!*wln_ptr)
-            return WLN_OK; 
+
+          frame = frame_push(FRAME_RESUME); 
+          frame->symbol = curr_symbol; 
+          frame->edge   = curr_edge; 
+          frame->ring   = ring; 
+          inline_edge = curr_edge; 
+          goto ring_block; 
         }
         else {
-          curr_symbol = dash_symbol_create(mol, &wln_ptr); 
-          edge_bond(mol, curr_edge, curr_symbol); 
-          if (!curr_symbol)
-            return wln_error("invalid elemental code - %s\n", wln_ptr);
-
-          for (unsigned int i=0; i<3; i++) {
-            curr_edge = edge_create(mol, curr_symbol); 
-            ret = branch_recursive_parse(mol, curr_symbol, curr_edge, ring); 
-            if (ret == WLN_ERROR)
-              return ret; 
-            if (!*wln_ptr)
-              break; 
+          atomic_num = dash_element(&wln_ptr); 
+          if (!atomic_num) {
+            wln_error(WLN_ERR_SYMBOL, "invalid elemental code - %s\n", wln_ptr);
+            goto parse_error; 
           }
-          return WLN_OK; 
+          curr_symbol = walk_symbol<BUILD>(mol, curr_edge, atomic_num); 
+          frame = frame_push(FRAME_ARMS); 
+          frame->arms = 3; 
+          goto arm_push; 
         }
         break;
 
       case ' ':
         if (*wln_ptr == '&') {
           wln_ptr++; 
-          return start_wln_parse(mol); 
+          goto component_start; 
         }
         else {
-          if (!ring) 
-            return wln_error("opening ring notation without a prior ring\n"); 
-          return parse_ring_locants(mol, ring); 
+          if (!CYCLIC || !ring) {
+            wln_error(WLN_ERR_RING, "opening ring notation without a prior ring\n"); 
+            goto parse_error; 
+          }
+          frame = frame_push(FRAME_LOCANTS); 
+          frame->ring = ring; 
+          goto locants_start; 
         }
         break; 
 
       case '&':
         /* branch must of closed */
-        return WLN_OK;
+        goto chain_close; 
 
       case '\n':
         break; 
       case '/':
-        return wln_error("slash seen outside of ring - multipliers currently unsupported\n");
+        wln_error(WLN_ERR_UNSUPPORTED, "slash seen outside of ring - multipliers currently unsupported\n");
+        goto parse_error; 
       default:
-        fprintf(stderr, "invalid character read for WLN notation - %c(%u)\n", ch, ch);
-        return false; 
+        wln_error(WLN_ERR_CHARACTER, "invalid character read for WLN notation - %c(%u)\n", ch, ch);
+        goto parse_error; 
     }
   }
-  
-  return WLN_OK; 
-}
+  goto chain_close; 
+
+  /* open the next arm of the branching symbol on top of the stack */
+arm_push:
+  frame->symbol = curr_symbol; 
+  frame->ring   = ring; 
+arm_next:
+  frame->arms--; 
+  curr_symbol = frame->symbol; 
+  curr_edge   = walk_edge<BUILD>(mol, curr_symbol); 
+  ring        = frame->ring; 
+  frame->edge = curr_edge; 
+  goto branch_start; 
+
+  /* this expects the entry character to be the character after the locant space */
+locants_start:
+  if (!*wln_ptr) {
+    wln_error(WLN_ERR_LOCANT, "locant space at the end of the notation\n"); 
+    goto parse_error;
+  }
 
+locants_next:
+  if (!*wln_ptr) {
+    frame_pop(); 
+    goto chain_close; 
+  }
 
-// init conditions, make one dummy atom, and one bond - work of the virtual bond
-// idea entirely *--> grow..., delete at the end to save branches
-static int start_wln_parse(graph_t *mol)
-{
-  bool starting_dioxy = false; 
-  symbol_t *init_symbol = symbol_create(mol, DUM); 
-  edge_t *init_edge = graph_new_edge(mol); 
-  edge_set_begin(init_edge, init_symbol); 
-
-  symbol_t *open_term = parse_opening_terminator(mol, *wln_ptr);
-  if (open_term) {
-    edge_bond(mol, init_edge, open_term); 
-    init_edge = edge_create(mol, open_term); 
+  if (*wln_ptr == '&') {
     wln_ptr++; 
-    if (*wln_ptr == 'H') {
-      symbol_incr_hydrogens(open_term);  
-      wln_ptr++; 
-    }
+    frame_pop(); 
+    goto component_start; 
   }
 
-  if (*wln_ptr == 'W') {
-    wln_ptr++; 
-    starting_dioxy = true; 
+  frame = &wln_stack[wln_stack_size-1]; 
+  locant = parse_locant(); 
+  if (locant == WLN_ERROR) {
+    wln_error(WLN_ERR_LOCANT, "failed to parse locant\n");  
+    goto parse_error; 
+  }
+  if (locant >= frame->ring->size) {
+    wln_error(WLN_ERR_LOCANT, "locant out of range of ring\n"); 
+    goto parse_error; 
   }
 
-  switch (*wln_ptr) {
-    case 'L':
-    case 'T':
+  ring        = frame->ring; 
+  curr_symbol = BUILD ? ring->path[locant].s : TOKEN_SYMBOL; 
+  curr_edge   = walk_edge<BUILD>(mol, curr_symbol); 
+  frame->edge = curr_edge; 
+  goto branch_start; 
+
+  /* this expects the character after the opening L|T */
+ring_block:
+  if (CYCLIC) {
+    ring = ring_alloc(); 
+    if (cyclic_block_parse<BUILD>(mol, ring, inline_edge, locant) != WLN_OK) {
+      ring_release(ring); 
+      goto parse_error; 
+    }
+
+    if (*wln_ptr == ' ') {
       wln_ptr++; 
-      if (cyclic_recursive_parse(mol, NULL, 0) == WLN_ERROR)
-        return WLN_ERROR; 
-      break; 
-    default:
-      if (branch_recursive_parse(mol, NULL, init_edge, NULL) == WLN_ERROR)
-        return WLN_ERROR; 
+      if (*wln_ptr == '&') {
+        wln_ptr++; 
+        ring_release(ring); 
+        goto component_start; 
+      }
+      frame = frame_push(FRAME_LOCANTS); 
+      frame->ring  = ring; 
+      frame->owned = true; 
+      goto locants_start; 
+    }
+    ring_release(ring); 
   }
 
-  if (starting_dioxy && edge_get_end(init_edge)) {
-    if (add_dioxo(mol, edge_get_end(init_edge)) != WLN_OK)
-      return WLN_ERROR; 
+  /* the active chain is done, resume whatever frame is waiting on it */
+chain_close:
+  if (!wln_stack_size)
+    return WLN_OK; 
+
+  frame = &wln_stack[wln_stack_size-1]; 
+  switch (frame->type) {
+    case FRAME_START:
+      init_symbol = frame->symbol; 
+      init_edge   = frame->edge; 
+      if (BUILD && frame->dioxo && edge_get_end(init_edge)) {
+        if (add_dioxo(mol, edge_get_end(init_edge)) != WLN_OK)
+          goto parse_error; 
+      }
+      frame_pop(); 
+
+      if (BUILD)
+        graph_delete_symbol(mol, init_symbol); 
+      if (BUILD ? graph_num_atoms(mol) == 0 : !wln_nsymbols) {
+        wln_error(WLN_ERR_EMPTY, "empty molecule from wln parse\n");
+        goto parse_error; 
+      }
+      goto chain_close; 
+
+    case FRAME_ARMS:
+      if (frame->methyl) {
+        if (BUILD && !edge_get_end(frame->edge)) {
+          symbol_t *methyl = symbol_create(mol, CAR);
+          edge_bond(mol, frame->edge, methyl);  
+        }
+      }
+      else if (!*wln_ptr)
+        frame->arms = 0; 
+
+      if (frame->arms)
+        goto arm_next; 
+      frame_pop(); 
+      goto chain_close; 
+
+    case FRAME_LOCANTS:
+      if (BUILD && !edge_get_end(frame->edge)) {
+        symbol_t *methyl = symbol_create(mol, CAR);
+        edge_bond(mol, frame->edge, methyl);  
+      }
+
+      if (*wln_ptr == '&') {
+        /* move out of the current ring */
+        wln_ptr++; 
+        frame_pop(); 
+        goto chain_close; 
+      }
+
+      /* move to the next locant */
+      if (*wln_ptr == ' ') {
+        wln_ptr++; 
+        if (*wln_ptr == '&') {
+          wln_ptr++; 
+          frame_pop(); 
+          goto component_start; 
+        }
+      }
+      goto locants_next; 
+
+    case FRAME_RESUME:
+      curr_symbol = frame->symbol; 
+      curr_edge   = frame->edge; 
+      ring        = frame->ring; 
+      frame_pop(); 
+      if (!*wln_ptr)
+        goto chain_close; 
+      goto branch_loop; 
   }
-  
-  graph_delete_symbol(mol, init_symbol); 
-  if (graph_num_atoms(mol) == 0)
-    return wln_error("empty molecule from wln parse\n");
+  return WLN_OK; 
 
-  return WLN_OK;
+parse_error:
+  while (wln_stack_size)
+    frame_pop(); 
+  return WLN_ERROR; 
+}
+
+
+/* 
+ * pre-scan for anything that opens a ring, L|T blocks, benzene R, inline 
+ * rings and ring locants. Dash elements containing these letters are sent 
+ * down the general path, which is always safe.
+ */
+static bool wln_is_acyclic(const char *wln)
+{
+  for (const char *ptr = wln; *ptr; ptr++) {
+    switch (*ptr) {
+      case 'L':
+      case 'T':
+      case 'R':
+        return false; 
+      case ' ':
+        if (ptr[1] != '&')
+          return false; 
+        break; 
+    }
+  }
+  return true; 
 }
 
 
 /*
  * -- Parse WLN Notation --
  */
+/* 
+ * single linear pass giving upper bounds on the atoms and bonds a notation 
+ * reads into. Chain digits count their carbons, ring blocks the sum of their 
+ * ring sizes or the multicyclic path size, ring locants the methyl an empty
+ * branch takes, and every other symbol its own atom plus the methyls or 
+ * oxygens it implies.
+ */
+unsigned int EstimateWLN(const char *wln, unsigned int *nbonds)
+{
+  unsigned int natoms = 1; // dummy start symbol
+  unsigned int bonds  = 1; 
+  unsigned int counter; 
+  unsigned int ring_size = 0; 
+  bool in_ring = false; 
+  bool locant  = false; 
+  unsigned char ch; 
+
+  const char *ptr = wln; 
+  while ((ch = *ptr++)) {
+    if (in_ring) {
+      switch (ch) {
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+          ring_size += ch - '0'; 
+          break; 
+
+        case ' ':
+          /* multicyclic block, path size is the locant after the multipliers */
+          if (*ptr >= '1' && *ptr <= '9') {
+            counter = *ptr - '0'; 
+            while (*ptr && counter--) 
+              ptr++; 
+            if (*ptr && *++ptr == ' ' && ptr[1] >= 'A' && ptr[1] <= 'Z') {
+              ptr++; 
+              counter = *ptr++ - 'A' + 1; 
+              while (*ptr == '&') {
+                counter += 23; 
+                ptr++; 
+              }
+              if (counter > ring_size)
+                ring_size = counter; 
+            }
+          }
+          break; 
+
+        case '/':
+          bonds++; // pseudo bond
+          break; 
+
+        case 'V':
+          natoms++; // ring carbonyl oxygen
+          bonds++; 
+          break; 
+
+        case 'W':
+          natoms += 2; 
+          bonds  += 2; 
+          break; 
+
+        case 'J':
+          if (*ptr == ' ' || !*ptr) {
+            natoms += ring_size; 
+            bonds  += ring_size + 1; 
+            in_ring = false; 
+          }
+          break; 
+      }
+      continue; 
+    }
+
+    if (locant) {
+      /* locant letter and its expansion marks, an empty branch is a methyl */
+      locant = false; 
+      if (ch >= 'A' && ch <= 'Z') {
+        while (*ptr == '&')
+          ptr++; 
+        natoms++; 
+        bonds++; 
+        continue; 
+      }
+    }
+
+    switch (ch) {
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+        counter = ch - '0'; 
+        while (*ptr >= '0' && *ptr <= '9') {
+          if (counter <= WLN_CHAIN_MAX)
+            counter = counter * 10 + (*ptr - '0'); 
+          ptr++; 
+        }
+        if (counter > WLN_CHAIN_MAX)
+          counter = WLN_CHAIN_MAX; // the read fails on it
+        natoms += counter; 
+        bonds  += counter; 
+        break; 
+
+      case 'L':
+      case 'T':
+        in_ring = true; 
+        ring_size = 0; 
+        break; 
+
+      case 'R':
+        natoms += 6; 
+        bonds  += 7; 
+        break; 
+
+      case 'X':
+      case 'K':
+        natoms += 4; 
+        bonds  += 4; 
+        break; 
+
+      case 'Y':
+        natoms += 3; 
+        bonds  += 3; 
+        break; 
+
+      case 'V':
+      case 'W':
+        natoms += 2; 
+        bonds  += 2; 
+        break; 
+
+      case 'H':
+      case 'U':
+        break; 
+
+      case '-':
+        if (*ptr == ' ') {
+          locant = true; 
+          ptr++; 
+        }
+        else {
+          while (*ptr && *ptr != '-')
+            ptr++; 
+          if (*ptr)
+            ptr++; 
+          natoms++; 
+          bonds++; 
+        }
+        break; 
+
+      case ' ':
+        if (*ptr == '&') {
+          natoms++; // next component dummy
+          bonds++; 
+          ptr++; 
+        }
+        else 
+          locant = true; 
+        break; 
+
+      default:
+        if (ch >= 'A' && ch <= 'Z') {
+          natoms++; 
+          bonds++; 
+        }
+        break; 
+    }
+  }
+
+  if (in_ring) {
+    natoms += ring_size; 
+    bonds  += ring_size + 1; 
+  }
+
+  if (nbonds)
+    *nbonds = bonds; 
+  return natoms; 
+}
+
+
+bool ValidateWLN(const char *wln)
+{
+  wln_ptr   = (char*)wln; 
+  wln_start = wln; 
+  wln_err.code = WLN_ERR_NONE; 
+
+  const bool acyclic = wln_chain_path && wln_is_acyclic(wln); 
+  const int ret = acyclic ? start_wln_parse<false, false>(NULL) : start_wln_parse<true, false>(NULL); 
+  if (ret == WLN_ERROR) {
+    wln_error(WLN_ERR_SYNTAX, "invalid notation\n"); 
+    return false; 
+  }
+
+  if (*wln_ptr) {
+    /* errors are recorded against the last character consumed */
+    wln_ptr++; 
+    wln_error(WLN_ERR_TRAILING, "parse ended before end of notation - %s\n", wln_ptr - 1); 
+    return false; 
+  }
+  return true; 
+}
+
+
 bool ReadWLN(const char *wln, graph_t *mol)
 {
 #ifdef USING_OPENBABEL
   mol->BeginModify(); 
+  graph_reserve(mol, EstimateWLN(wln, NULL)); 
   mol->SetAromaticPerceived(true);
   mol->SetChiralityPerceived(true); // no stereo for WLN
 #endif
   
-  wln_ptr = (char*)wln; 
-  if (start_wln_parse(mol) == WLN_ERROR)
+  wln_ptr   = (char*)wln; 
+  wln_start = wln; 
+  wln_err.code = WLN_ERR_NONE; 
+
+  const bool acyclic = wln_chain_path && wln_is_acyclic(wln); 
+  const int ret = acyclic ? start_wln_parse<false, true>(mol) : start_wln_parse<true, true>(mol); 
+  if (ret == WLN_ERROR) {
+    /* some grammar failures return without a message */
+    wln_error(WLN_ERR_SYNTAX, "invalid notation\n"); 
     return false; 
+  }
 
   if (*wln_ptr) {
-    wln_error("parse ended before end of notation - %s\n", wln_ptr); 
+    /* errors are recorded against the last character consumed */
+    wln_ptr++; 
+    wln_error(WLN_ERR_TRAILING, "parse ended before end of notation - %s\n", wln_ptr - 1); 
     return false; 
   }
 
@@ -1573,7 +1925,211 @@ bool ReadWLN(const char *wln, graph_t *mol)
 #ifdef USING_OPENBABEL
   OBKekulize(mol); 
 #endif
+  wln_err.code = WLN_ERR_NONE; 
   return true; 
 }
 
 
+const struct wln_parse_error* WLNLastError()
+{
+  return &wln_err; 
+}
+
+
+const char* WLNErrorString(int code)
+{
+  switch (code) {
+    case WLN_ERR_NONE:        return "no error"; 
+    case WLN_ERR_SYNTAX:      return "invalid notation"; 
+    case WLN_ERR_CHARACTER:   return "invalid character"; 
+    case WLN_ERR_SYMBOL:      return "invalid symbol"; 
+    case WLN_ERR_LOCANT:      return "invalid locant"; 
+    case WLN_ERR_RING:        return "invalid ring notation"; 
+    case WLN_ERR_UNSUPPORTED: return "unsupported notation"; 
+    case WLN_ERR_EMPTY:       return "empty molecule"; 
+    case WLN_ERR_TRAILING:    return "unparsed trailing notation"; 
+  }
+  return "unknown error"; 
+}
+
+
+void WLNSetLogging(bool log)
+{
+  wln_logging = log; 
+}
+
+
+#ifdef WLN_TEST_HOOKS
+/* not thread safe, must not be called while reads are in flight */
+void WLNTestChainPath(bool enable)
+{
+  wln_chain_path = enable; 
+}
+
+
+bool WLNTestAcyclic(const char *wln)
+{
+  return wln_is_acyclic(wln); 
+}
+#endif
+
+
+/*
+ * -- Batch Parse WLN Notation --
+ *
+ * Workers claim records in chunks from a shared counter, each keeps its own 
+ * molecule and scratch string for the whole batch. Errors are never printed,
+ * the callback receives the parse status of every record and failures are 
+ * tallied per code into the summary. 
+ */
+#define WLN_BATCH_CHUNK 64
+
+struct wlnbatch {
+  const char *buffer; 
+  const size_t *offsets; 
+  unsigned int nrecords; 
+  unsigned int next;  /* next unclaimed record, shared */
+  unsigned int nread; /* successful parses, shared */
+  struct wln_batch_summary *summary; 
+  wln_read_callback callback; 
+  void *data; 
+  bool *valid;        /* set for a validation batch, no molecules are built */
+};
+
+
+static void* wln_batch_worker(void *arg)
+{
+  struct wlnbatch *batch = (struct wlnbatch*)arg; 
+  graph_t mol; 
+
+  size_t nscratch = 1024; 
+  char *scratch = (char*)malloc(nscratch); 
+  unsigned int nread = 0; 
+  unsigned int ncodes[WLN_ERR_MAX] = {0}; 
+
+  wln_quiet = true; 
+  for (;;) {
+    unsigned int start = __atomic_fetch_add(&batch->next, WLN_BATCH_CHUNK, __ATOMIC_RELAXED); 
+    if (start >= batch->nrecords)
+      break; 
+
+    unsigned int end = batch->nrecords - start > WLN_BATCH_CHUNK ? start + WLN_BATCH_CHUNK : batch->nrecords; 
+    for (unsigned int i=start; i<end; i++) {
+      const size_t len = batch->offsets[i+1] - batch->offsets[i]; 
+      if (len >= nscratch) {
+        while (len >= nscratch)
+          nscratch *= 2; 
+        scratch = (char*)realloc(scratch, nscratch); 
+      }
+      memcpy(scratch, batch->buffer + batch->offsets[i], len); 
+      scratch[len] = '\0'; 
+
+      if (batch->valid) {
+        batch->valid[i] = ValidateWLN(scratch); 
+        nread += batch->valid[i]; 
+        continue; 
+      }
+
+      bool ok = ReadWLN(scratch, &mol); 
+      nread += ok; 
+      if (!ok)
+        ncodes[wln_err.code]++; 
+      if (batch->callback)
+        batch->callback(i, ok, &mol, batch->data); 
+      graph_clear((&mol)); 
+    }
+  }
+  wln_quiet = false; 
+
+  __atomic_fetch_add(&batch->nread, nread, __ATOMIC_RELAXED); 
+  if (batch->summary) {
+    for (unsigned int c=0; c<WLN_ERR_MAX; c++) {
+      if (ncodes[c])
+        __atomic_fetch_add(&batch->summary->ncodes[c], ncodes[c], __ATOMIC_RELAXED); 
+    }
+  }
+  parse_stack_free(); 
+  free(scratch); 
+  return NULL; 
+}
+
+
+static void wln_batch_run(struct wlnbatch *batch, unsigned int nthreads)
+{
+  if (nthreads > batch->nrecords / WLN_BATCH_CHUNK)
+    nthreads = batch->nrecords / WLN_BATCH_CHUNK; 
+
+  if (nthreads <= 1)
+    wln_batch_worker(batch); 
+  else {
+    pthread_t *workers = (pthread_t*)malloc(nthreads*sizeof(pthread_t)); 
+    unsigned int nworkers = 0; 
+    for (; nworkers < nthreads; nworkers++) {
+      if (pthread_create(&workers[nworkers], NULL, wln_batch_worker, batch) != 0)
+        break; 
+    }
+
+    /* if no threads could be made, the calling thread does the work */
+    if (!nworkers)
+      wln_batch_worker(batch); 
+
+    for (unsigned int i=0; i<nworkers; i++)
+      pthread_join(workers[i], NULL); 
+    free(workers); 
+  }
+}
+
+
+unsigned int ReadWLNBatch(const char *buffer, 
+                          const size_t *offsets, 
+                          unsigned int nrecords, 
+                          wln_read_callback callback, 
+                          void *data, 
+                          unsigned int nthreads, 
+                          struct wln_batch_summary *summary)
+{
+  if (summary)
+    memset(summary, 0, sizeof(struct wln_batch_summary)); 
+
+  struct wlnbatch batch; 
+  batch.buffer   = buffer; 
+  batch.offsets  = offsets; 
+  batch.nrecords = nrecords; 
+  batch.next     = 0; 
+  batch.nread    = 0; 
+  batch.callback = callback; 
+  batch.data     = data; 
+  batch.summary  = summary; 
+
+  batch.valid    = (bool*)0; 
+
+  wln_batch_run(&batch, nthreads); 
+
+  if (summary) {
+    summary->nread   = batch.nread; 
+    summary->nfailed = nrecords - batch.nread; 
+  }
+  return batch.nread; 
+}
+
+
+unsigned int ValidateWLNBatch(const char *buffer, 
+                              const size_t *offsets, 
+                              unsigned int nrecords, 
+                              bool *valid, 
+                              unsigned int nthreads)
+{
+  struct wlnbatch batch; 
+  batch.buffer   = buffer; 
+  batch.offsets  = offsets; 
+  batch.nrecords = nrecords; 
+  batch.next     = 0; 
+  batch.nread    = 0; 
+  batch.callback = (wln_read_callback)0; 
+  batch.data     = NULL; 
+  batch.summary  = (struct wln_batch_summary*)0; 
+  batch.valid    = valid; 
+
+  wln_batch_run(&batch, nthreads); 
+  return batch.nread; 
+}
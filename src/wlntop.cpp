@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "wlntop.h"
+
+
+void wln_top_init(struct wln_top *top, unsigned int capacity)
+{
+  top->capacity = capacity ? capacity : 1;
+  top->n        = 0;
+  top->entries  = (struct wln_top_entry*)malloc(top->capacity * sizeof(struct wln_top_entry));
+  top->heap     = (unsigned int*)malloc(top->capacity * sizeof(unsigned int));
+
+  /* at most half full, chains stay short */
+  top->nbuckets = 16;
+  while (top->nbuckets < 2 * top->capacity)
+    top->nbuckets *= 2;
+  top->buckets = (unsigned int*)malloc(top->nbuckets * sizeof(unsigned int));
+  for (unsigned int i = 0; i < top->nbuckets; i++)
+    top->buckets[i] = top->capacity;
+}
+
+
+void wln_top_free(struct wln_top *top)
+{
+  for (unsigned int i = 0; i < top->n; i++)
+    free(top->entries[i].str);
+  free(top->entries);
+  free(top->heap);
+  free(top->buckets);
+  top->entries = (struct wln_top_entry*)0;
+  top->heap    = (unsigned int*)0;
+  top->buckets = (unsigned int*)0;
+  top->n = 0;
+}
+
+
+/* fnv-1a, matches are short */
+static unsigned int top_hash(const char *str, size_t n)
+{
+  unsigned int h = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    h ^= (unsigned char)str[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+
+static void heap_swap(struct wln_top *top, unsigned int a, unsigned int b)
+{
+  const unsigned int t = top->heap[a];
+  top->heap[a] = top->heap[b];
+  top->heap[b] = t;
+  top->entries[top->heap[a]].heap = a;
+  top->entries[top->heap[b]].heap = b;
+}
+
+
+/* counts only ever grow, so entries only move down */
+static void heap_down(struct wln_top *top, unsigned int i)
+{
+  for (;;) {
+    unsigned int least = i;
+    const unsigned int l = 2*i + 1;
+    const unsigned int r = 2*i + 2;
+    if (l < top->n && top->entries[top->heap[l]].count < top->entries[top->heap[least]].count)
+      least = l;
+    if (r < top->n && top->entries[top->heap[r]].count < top->entries[top->heap[least]].count)
+      least = r;
+    if (least == i)
+      return;
+    heap_swap(top, i, least);
+    i = least;
+  }
+}
+
+
+static void heap_up(struct wln_top *top, unsigned int i)
+{
+  while (i) {
+    const unsigned int parent = (i - 1) / 2;
+    if (top->entries[top->heap[parent]].count <= top->entries[top->heap[i]].count)
+      return;
+    heap_swap(top, i, parent);
+    i = parent;
+  }
+}
+
+
+static void bucket_remove(struct wln_top *top, unsigned int e)
+{
+  const struct wln_top_entry *entry = &top->entries[e];
+  unsigned int *link = &top->buckets[top_hash(entry->str, entry->len) & (top->nbuckets - 1)];
+  while (*link != e)
+    link = &top->entries[*link].next;
+  *link = entry->next;
+}
+
+
+/* count and error are weights, a merged string brings its own */
+static void top_insert(struct wln_top *top, const char *str, size_t n,
+                       unsigned long count, unsigned long error)
+{
+  const unsigned int b = top_hash(str, n) & (top->nbuckets - 1);
+  for (unsigned int e = top->buckets[b]; e != top->capacity; e = top->entries[e].next) {
+    struct wln_top_entry *entry = &top->entries[e];
+    if (entry->len == n && !memcmp(entry->str, str, n)) {
+      entry->count += count;
+      entry->error += error;
+      heap_down(top, entry->heap);
+      return;
+    }
+  }
+
+  unsigned int e;
+  unsigned long floor = 0;
+  if (top->n < top->capacity) {
+    e = top->n;
+    top->entries[e].str = (char*)0;
+    top->entries[e].heap = top->n;
+    top->heap[top->n++] = e;
+  }
+  else {
+    /* the least counted string gives up its slot, and its count */
+    e = top->heap[0];
+    floor = top->entries[e].count;
+    bucket_remove(top, e);
+  }
+
+  struct wln_top_entry *entry = &top->entries[e];
+  entry->str   = (char*)realloc(entry->str, n ? n : 1);
+  memcpy(entry->str, str, n);
+  entry->len   = n;
+  entry->count = floor + count;
+  entry->error = floor + error;
+  entry->next  = top->buckets[b];
+  top->buckets[b] = e;
+
+  if (floor)
+    heap_down(top, entry->heap);
+  else
+    heap_up(top, entry->heap);
+}
+
+
+void wln_top_add(struct wln_top *top, const char *str, size_t n)
+{
+  top_insert(top, str, n, 1, 0);
+}
+
+
+void wln_top_merge(struct wln_top *dst, const struct wln_top *src)
+{
+  for (unsigned int i = 0; i < src->n; i++) {
+    const struct wln_top_entry *entry = &src->entries[i];
+    top_insert(dst, entry->str, entry->len, entry->count, entry->error);
+  }
+}
+
+
+static int top_compare(const void *a, const void *b)
+{
+  const struct wln_top_entry *x = (const struct wln_top_entry*)a;
+  const struct wln_top_entry *y = (const struct wln_top_entry*)b;
+  if (x->count != y->count)
+    return x->count < y->count ? 1 : -1;
+  const unsigned int n = x->len < y->len ? x->len : y->len;
+  const int c = memcmp(x->str, y->str, n);
+  if (c)
+    return c;
+  return x->len < y->len ? -1 : x->len > y->len;
+}
+
+
+unsigned int wln_top_sort(struct wln_top *top)
+{
+  qsort(top->entries, top->n, sizeof(struct wln_top_entry), top_compare);
+  return top->n;
+}
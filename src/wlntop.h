@@ -0,0 +1,47 @@
+#ifndef WLN_TOP_H
+#define WLN_TOP_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * bounded memory heavy hitter counts, the space saving summary. A fixed
+ * number of strings are counted, a new string takes over the slot of the
+ * least counted one and inherits its count as the error. Every count is an
+ * over estimate by at most its error, and any string making up more than
+ * 1/capacity of all counted is sure to hold a slot. Summaries merge by
+ * adding one into the other with weights, so parallel workers keep their
+ * own.
+ */
+
+struct wln_top_entry {
+  char *str;
+  unsigned int len;
+  unsigned int heap;   // position in the min heap
+  unsigned int next;   // bucket chain, capacity for the end
+  unsigned long count;
+  unsigned long error;
+};
+
+struct wln_top {
+  unsigned int capacity;
+  unsigned int n;
+  struct wln_top_entry *entries;
+  unsigned int *heap;    // entries by count, least first
+  unsigned int *buckets;
+  unsigned int nbuckets; // power of two
+};
+
+void wln_top_init(struct wln_top *top, unsigned int capacity);
+void wln_top_free(struct wln_top *top);
+
+/* counts one more of the n bytes at str */
+void wln_top_add(struct wln_top *top, const char *str, size_t n);
+
+/* adds every string of src into dst */
+void wln_top_merge(struct wln_top *dst, const struct wln_top *src);
+
+/* orders the entries by count, most first, after which they are only read */
+unsigned int wln_top_sort(struct wln_top *top);
+
+#endif
@@ -17,6 +17,8 @@ GNU General Public License for more details.
 ***********************************************************************/
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 
 #include <openbabel/mol.h>
 #include <openbabel/plugin.h>
@@ -32,8 +34,8 @@ GNU General Public License for more details.
 #include <openbabel/stereo/tetrahedral.h>
 
 #include "wlnparser.h"
+#include "wlnelements.h"
 
-#define DEBUG
 #define WLN_OK 0
 #define WLN_ERROR -1
 
@@ -98,25 +100,156 @@ using namespace OpenBabel;
 #define int_to_locant(X) (X+64)
 #define locant_to_int(X) (X-64)
 
-char *wln_out; 
-unsigned int wln_len; 
-bool *seen; 
+/* 
+ * writer state is per thread, the seen workspace is kept between calls.
+ *
+ * Output is emitted into a growable target buffer at offset wln_base, runs of 
+ * chain carbons are counted rather than written, and land as a single chain 
+ * length when the next symbol is pushed. 
+ */
+static thread_local char **wln_buf; 
+static thread_local size_t *wln_alloc; 
+static thread_local size_t wln_base; 
+static thread_local size_t wln_len; 
+static thread_local unsigned int wln_chain; 
 
-#define wln_push(ch)        wln_out[wln_len++] = ch
-#define wln_pop()           wln_out[--wln_len] = '\0'
-#define wln_back()          wln_out[wln_len-1]
-#define wln_terminate()     wln_out[wln_len] = '\0'
-#define wln_length()        wln_len
-#define wln_at(n)           wln_out[n]
-#define wln_set(ch, n)      wln_out[n] = ch
-#define wln_ptr(n)          &wln_out[n]
-#define wln_end_ptr()       &wln_out[wln_len-1]
+static thread_local char *wln_scratch; 
+static thread_local size_t wln_scratch_alloc; 
+
+static thread_local bool *seen; 
+static thread_local unsigned int seen_alloc; 
+
+#define wln_ptr(n)          (*wln_buf + wln_base + (n))
+
+
+static void wln_target(char **buffer, size_t *nbuffer, size_t base)
+{
+  wln_buf   = buffer; 
+  wln_alloc = nbuffer; 
+  wln_base  = base; 
+  wln_len   = 0; 
+  wln_chain = 0; 
+}
+
+
+/* make room for n more characters and a terminator */
+static void wln_reserve(size_t n)
+{
+  const size_t need = wln_base + wln_len + n + 1; 
+  if (need > *wln_alloc) {
+    size_t alloc = *wln_alloc ? *wln_alloc : 64; 
+    while (alloc < need)
+      alloc *= 2; 
+    *wln_buf   = (char*)realloc(*wln_buf, alloc); 
+    *wln_alloc = alloc; 
+  }
+}
+
+
+static void wln_flush_chain()
+{
+  if (!wln_chain)
+    return; 
+
+  char digits[10]; 
+  unsigned int ndigits = 0; 
+  while (wln_chain) {
+    digits[ndigits++] = (wln_chain % 10) + '0'; 
+    wln_chain /= 10; 
+  }
+
+  wln_reserve(ndigits); 
+  while (ndigits)
+    *wln_ptr(wln_len++) = digits[--ndigits]; 
+}
+
+
+static void wln_push(unsigned char ch)
+{
+  wln_flush_chain(); 
+  wln_reserve(1); 
+  *wln_ptr(wln_len++) = ch; 
+}
+
+
+/* copies a preformatted token in one go */
+static void wln_push_token(const char *token, size_t n)
+{
+  wln_flush_chain(); 
+  wln_reserve(n); 
+  memcpy(wln_ptr(wln_len), token, n); 
+  wln_len += n; 
+}
+
+
+/* locants past Z take a letter and '&' expansions, each adding 23 as the 
+ * reader decodes them */
+static void wln_push_locant(unsigned int pos)
+{
+  unsigned int expand = 0; 
+  if (pos >= 26) {
+    expand = (pos - 26) / 23 + 1; 
+    pos -= 23 * expand; 
+  }
+  wln_push(pos + 'A'); 
+  while (expand--)
+    wln_push('&'); 
+}
+
+
+static void wln_push_chain()
+{
+  wln_chain++; 
+}
+
+
+static unsigned char wln_back()
+{
+  return wln_chain ? '1' : *wln_ptr(wln_len-1); 
+}
+
+
+static void wln_pop()
+{
+  if (wln_chain)
+    wln_chain--; 
+  else 
+    *wln_ptr(--wln_len) = '\0'; 
+}
+
+
+static void wln_terminate()
+{
+  wln_flush_chain(); 
+  wln_reserve(0); 
+  *wln_ptr(wln_len) = '\0'; 
+}
+
+
+static size_t wln_length()
+{
+  wln_flush_chain(); 
+  return wln_len; 
+}
 
 
 static int locant_recursive_write(struct wln_ring *wln_ring, graph_t *mol); 
 static int branch_recursive_write(graph_t *mol, symbol_t *atom); 
 
 
+/* ids are not renumbered when atoms are deleted, workspaces indexed by id 
+ * are sized from the largest */
+static unsigned int graph_id_bound(graph_t *mol)
+{
+  unsigned int bound = 0; 
+  graph_symbol_iter(s, mol) {
+    if (symbol_get_id(s) >= bound)
+      bound = symbol_get_id(s) + 1; 
+  }
+  return bound; 
+}
+
+
 static bool is_wln_V(symbol_t *atom)
 {
   if (symbol_get_valence(atom) == 4 &&
@@ -150,11 +283,8 @@ static void wln_write_element_symbol(OBAtom* atom) {
     case 1: wln_push('H'); break; 
 
     case 5:
-      if (orders > 3) {
-        wln_push('-');  
-        wln_push('B');  
-        wln_push('-');  
-      }
+      if (orders > 3)
+        wln_push_token("-B-", 3); 
       else 
         wln_push('H'); 
       break; 
@@ -163,7 +293,7 @@ static void wln_write_element_symbol(OBAtom* atom) {
       if (is_wln_V(atom)) 
         wln_push('V'); 
       else if (neighbours <= 2)
-        wln_push('1');
+        wln_push_chain();
       else if(neighbours == 3)
         wln_push('Y');
       else if(neighbours == 4)
@@ -177,11 +307,8 @@ static void wln_write_element_symbol(OBAtom* atom) {
           wln_push('M');
         else if (charge == +1 && orders == 4)
           wln_push('K');
-        else if (orders >= 4) {
-          wln_push('-');  
-          wln_push('N');  
-          wln_push('-');  
-        }
+        else if (orders >= 4)
+          wln_push_token("-N-", 3); 
         else 
           wln_push('N');  
         break; 
@@ -191,31 +318,22 @@ static void wln_write_element_symbol(OBAtom* atom) {
         wln_push('Q');
       else if (neighbours == 0 && charge != -2)
         wln_push('Q');
-      else if (orders > 2) {
-        wln_push('-');  
-        wln_push('O');  
-        wln_push('-');  
-      }
+      else if (orders > 2)
+        wln_push_token("-O-", 3); 
       else
         wln_push('O');  
       break; 
         
     case 9:
-      if (neighbours > 1) {
-        wln_push('-');  
-        wln_push('F');  
-        wln_push('-');  
-      }
+      if (neighbours > 1)
+        wln_push_token("-F-", 3); 
       else 
         wln_push('F');  
       break; 
 
     case 15:
-      if (neighbours > 5) {
-        wln_push('-');  
-        wln_push('P');  
-        wln_push('-');  
-      }
+      if (neighbours > 5)
+        wln_push_token("-P-", 3); 
       else 
         wln_push('P');  
       break; 
@@ -223,153 +341,51 @@ static void wln_write_element_symbol(OBAtom* atom) {
     case 16: wln_push('S'); break; 
 
     case 17:
-      if (neighbours > 1) {
-        wln_push('-');  
-        wln_push('G');  
-        wln_push('-');  
-      }
+      if (neighbours > 1)
+        wln_push_token("-G-", 3); 
       else 
         wln_push('G');  
       break; 
 
     case 35:
-      if (neighbours > 1) {
-        wln_push('-');  
-        wln_push('E');  
-        wln_push('-');  
-      }
+      if (neighbours > 1)
+        wln_push_token("-E-", 3); 
       else 
         wln_push('E');  
       break; 
 
     case 53:
-      if (neighbours > 1) {
-        wln_push('-');  
-        wln_push('I');  
-        wln_push('-');  
-      }
+      if (neighbours > 1)
+        wln_push_token("-I-", 3); 
       else 
         wln_push('I');  
       break; 
 
-      case 89: wln_push('-'); wln_push('A'); wln_push('C'); wln_push('-'); break;
-      case 47: wln_push('-'); wln_push('A'); wln_push('G'); wln_push('-'); break;
-      case 13: wln_push('-'); wln_push('A'); wln_push('L'); wln_push('-'); break;
-      case 95: wln_push('-'); wln_push('A'); wln_push('M'); wln_push('-'); break;
-      case 18: wln_push('-'); wln_push('A'); wln_push('R'); wln_push('-'); break;
-      case 33: wln_push('-'); wln_push('A'); wln_push('S'); wln_push('-'); break;
-      case 85: wln_push('-'); wln_push('A'); wln_push('T'); wln_push('-'); break;
-      case 79: wln_push('-'); wln_push('A'); wln_push('U'); wln_push('-'); break;
-      case 56: wln_push('-'); wln_push('B'); wln_push('A'); wln_push('-'); break;
-      case 4: wln_push('-'); wln_push('B'); wln_push('E'); wln_push('-'); break;
-      case 107: wln_push('-'); wln_push('B'); wln_push('H'); wln_push('-'); break;
-      case 83: wln_push('-'); wln_push('B'); wln_push('I'); wln_push('-'); break;
-      case 97: wln_push('-'); wln_push('B'); wln_push('K'); wln_push('-'); break;
-      case 20: wln_push('-'); wln_push('C'); wln_push('A'); wln_push('-'); break;
-      case 48: wln_push('-'); wln_push('C'); wln_push('D'); wln_push('-'); break;
-      case 58: wln_push('-'); wln_push('C'); wln_push('E'); wln_push('-'); break;
-      case 98: wln_push('-'); wln_push('C'); wln_push('F'); wln_push('-'); break;
-      case 96: wln_push('-'); wln_push('C'); wln_push('N'); wln_push('-'); break;
-      case 112: wln_push('-'); wln_push('C'); wln_push('N'); wln_push('-'); break;
-      case 27: wln_push('-'); wln_push('C'); wln_push('O'); wln_push('-'); break;
-      case 24: wln_push('-'); wln_push('C'); wln_push('R'); wln_push('-'); break;
-      case 55: wln_push('-'); wln_push('C'); wln_push('S'); wln_push('-'); break;
-      case 29: wln_push('-'); wln_push('C'); wln_push('U'); wln_push('-'); break;
-      case 105: wln_push('-'); wln_push('D'); wln_push('B'); wln_push('-'); break;
-      case 110: wln_push('-'); wln_push('D'); wln_push('S'); wln_push('-'); break;
-      case 66: wln_push('-'); wln_push('D'); wln_push('Y'); wln_push('-'); break;
-      case 68: wln_push('-'); wln_push('E'); wln_push('R'); wln_push('-'); break;
-      case 99: wln_push('-'); wln_push('E'); wln_push('S'); wln_push('-'); break;
-      case 63: wln_push('-'); wln_push('E'); wln_push('U'); wln_push('-'); break;
-      case 26: wln_push('-'); wln_push('F'); wln_push('E'); wln_push('-'); break;
-      case 114: wln_push('-'); wln_push('F'); wln_push('L'); wln_push('-'); break;
-      case 100: wln_push('-'); wln_push('F'); wln_push('M'); wln_push('-'); break;
-      case 87: wln_push('-'); wln_push('F'); wln_push('R'); wln_push('-'); break;
-      case 31: wln_push('-'); wln_push('G'); wln_push('A'); wln_push('-'); break;
-      case 64: wln_push('-'); wln_push('G'); wln_push('D'); wln_push('-'); break;
-      case 32: wln_push('-'); wln_push('G'); wln_push('E'); wln_push('-'); break;
-      case 2: wln_push('-'); wln_push('H'); wln_push('E'); wln_push('-'); break;
-      case 72: wln_push('-'); wln_push('H'); wln_push('F'); wln_push('-'); break;
-      case 80: wln_push('-'); wln_push('H'); wln_push('G'); wln_push('-'); break;
-      case 67: wln_push('-'); wln_push('H'); wln_push('O'); wln_push('-'); break;
-      case 108: wln_push('-'); wln_push('H'); wln_push('S'); wln_push('-'); break;
-      case 49: wln_push('-'); wln_push('I'); wln_push('N'); wln_push('-'); break;
-      case 77: wln_push('-'); wln_push('I'); wln_push('R'); wln_push('-'); break;
-      case 36: wln_push('-'); wln_push('K'); wln_push('R'); wln_push('-'); break;
-      case 19: wln_push('-'); wln_push('K'); wln_push('A'); wln_push('-'); break;
-      case 57: wln_push('-'); wln_push('L'); wln_push('A'); wln_push('-'); break;
-      case 3: wln_push('-'); wln_push('L'); wln_push('I'); wln_push('-'); break;
-      case 103: wln_push('-'); wln_push('L'); wln_push('R'); wln_push('-'); break;
-      case 71: wln_push('-'); wln_push('L'); wln_push('U'); wln_push('-'); break;
-      case 116: wln_push('-'); wln_push('L'); wln_push('V'); wln_push('-'); break;
-      case 115: wln_push('-'); wln_push('M'); wln_push('C'); wln_push('-'); break;
-      case 101: wln_push('-'); wln_push('M'); wln_push('D'); wln_push('-'); break;
-      case 12: wln_push('-'); wln_push('M'); wln_push('G'); wln_push('-'); break;
-      case 25: wln_push('-'); wln_push('M'); wln_push('N'); wln_push('-'); break;
-      case 42: wln_push('-'); wln_push('M'); wln_push('O'); wln_push('-'); break;
-      case 109: wln_push('-'); wln_push('M'); wln_push('T'); wln_push('-'); break;
-      case 11: wln_push('-'); wln_push('N'); wln_push('A'); wln_push('-'); break;
-      case 41: wln_push('-'); wln_push('N'); wln_push('B'); wln_push('-'); break;
-      case 60: wln_push('-'); wln_push('N'); wln_push('D'); wln_push('-'); break;
-      case 10: wln_push('-'); wln_push('N'); wln_push('E'); wln_push('-'); break;
-      case 113: wln_push('-'); wln_push('N'); wln_push('H'); wln_push('-'); break;
-      case 28: wln_push('-'); wln_push('N'); wln_push('I'); wln_push('-'); break;
-      case 102: wln_push('-'); wln_push('N'); wln_push('O'); wln_push('-'); break;
-      case 93: wln_push('-'); wln_push('N'); wln_push('P'); wln_push('-'); break;
-      case 118: wln_push('-'); wln_push('O'); wln_push('G'); wln_push('-'); break;
-      case 76: wln_push('-'); wln_push('O'); wln_push('S'); wln_push('-'); break;
-      case 91: wln_push('-'); wln_push('P'); wln_push('A'); wln_push('-'); break;
-      case 82: wln_push('-'); wln_push('P'); wln_push('B'); wln_push('-'); break;
-      case 46: wln_push('-'); wln_push('P'); wln_push('D'); wln_push('-'); break;
-      case 61: wln_push('-'); wln_push('P'); wln_push('M'); wln_push('-'); break;
-      case 84: wln_push('-'); wln_push('P'); wln_push('O'); wln_push('-'); break;
-      case 59: wln_push('-'); wln_push('P'); wln_push('R'); wln_push('-'); break;
-      case 78: wln_push('-'); wln_push('P'); wln_push('T'); wln_push('-'); break;
-      case 94: wln_push('-'); wln_push('P'); wln_push('U'); wln_push('-'); break;
-      case 88: wln_push('-'); wln_push('R'); wln_push('A'); wln_push('-'); break;
-      case 37: wln_push('-'); wln_push('R'); wln_push('B'); wln_push('-'); break;
-      case 75: wln_push('-'); wln_push('R'); wln_push('E'); wln_push('-'); break;
-      case 104: wln_push('-'); wln_push('R'); wln_push('F'); wln_push('-'); break;
-      case 111: wln_push('-'); wln_push('R'); wln_push('G'); wln_push('-'); break;
-      case 45: wln_push('-'); wln_push('R'); wln_push('H'); wln_push('-'); break;
-      case 86: wln_push('-'); wln_push('R'); wln_push('N'); wln_push('-'); break;
-      case 44: wln_push('-'); wln_push('R'); wln_push('U'); wln_push('-'); break;
-      case 51: wln_push('-'); wln_push('S'); wln_push('B'); wln_push('-'); break;
-      case 21: wln_push('-'); wln_push('S'); wln_push('C'); wln_push('-'); break;
-      case 34: wln_push('-'); wln_push('S'); wln_push('E'); wln_push('-'); break;
-      case 106: wln_push('-'); wln_push('S'); wln_push('G'); wln_push('-'); break;
-      case 14: wln_push('-'); wln_push('S'); wln_push('I'); wln_push('-'); break;
-      case 62: wln_push('-'); wln_push('S'); wln_push('M'); wln_push('-'); break;
-      case 50: wln_push('-'); wln_push('S'); wln_push('N'); wln_push('-'); break;
-      case 38: wln_push('-'); wln_push('S'); wln_push('R'); wln_push('-'); break;
-      case 73: wln_push('-'); wln_push('T'); wln_push('A'); wln_push('-'); break;
-      case 65: wln_push('-'); wln_push('T'); wln_push('B'); wln_push('-'); break;
-      case 43: wln_push('-'); wln_push('T'); wln_push('C'); wln_push('-'); break;
-      case 52: wln_push('-'); wln_push('T'); wln_push('E'); wln_push('-'); break;
-      case 90: wln_push('-'); wln_push('T'); wln_push('H'); wln_push('-'); break;
-      case 22: wln_push('-'); wln_push('T'); wln_push('I'); wln_push('-'); break;
-      case 81: wln_push('-'); wln_push('T'); wln_push('L'); wln_push('-'); break;
-      case 69: wln_push('-'); wln_push('T'); wln_push('M'); wln_push('-'); break;
-      case 117: wln_push('-'); wln_push('T'); wln_push('S'); wln_push('-'); break;
-      case 92: wln_push('-'); wln_push('U'); wln_push('R'); wln_push('-'); break;
-      case 23: wln_push('-'); wln_push('V'); wln_push('A'); wln_push('-'); break;
-      case 74: wln_push('-'); wln_push('W'); wln_push('T'); wln_push('-'); break;
-      case 54: wln_push('-'); wln_push('X'); wln_push('E'); wln_push('-'); break;
-      case 39: wln_push('-'); wln_push('Y'); wln_push('T'); wln_push('-'); break;
-      case 70: wln_push('-'); wln_push('Y'); wln_push('B'); wln_push('-'); break;
-      case 30: wln_push('-'); wln_push('Z'); wln_push('N'); wln_push('-'); break;
-      case 40: wln_push('-'); wln_push('Z'); wln_push('R'); wln_push('-'); break;
+    default: 
+      if (atom->GetAtomicNum() < WLN_ELEMENTS && 
+          wln_element_token[atom->GetAtomicNum()][0])
+        wln_push_token(wln_element_token[atom->GetAtomicNum()], 4); 
+      break; 
   }
 }
 
 
+/* inline capacities cover typical drug-like systems, larger ring 
+ * systems spill the subcycle list and multi bitset onto the heap */
+#define WLN_RING_SSSR_INLINE  32
+#define WLN_RING_MULTI_INLINE 1
+
 struct wln_ring {
   unsigned int size;
   unsigned int nsssr;
+  unsigned int sssr_alloc; 
+  unsigned int multi_words; 
   unsigned int fsum;
-  unsigned long long multi; // bitset 
+  unsigned long long *multi; // bitset, one bit per locant 
   bool hetero;
-  ring_t *sssr[32]; 
+  ring_t **sssr; 
+  ring_t *sssr_inline[WLN_RING_SSSR_INLINE]; 
+  unsigned long long multi_inline[WLN_RING_MULTI_INLINE]; 
   symbol_t *locants[1];
 }; 
 
@@ -382,24 +398,61 @@ static struct wln_ring* wln_ring_alloc(size_t size)
   r->size = size; 
   r->nsssr  = 0; 
   r->fsum   = 0xFFFFFFFF; 
-  r->multi  = 0; 
   r->hetero = false; 
+
+  r->sssr       = r->sssr_inline; 
+  r->sssr_alloc = WLN_RING_SSSR_INLINE; 
+
+  r->multi_words = (size + 63) / 64; 
+  if (r->multi_words <= WLN_RING_MULTI_INLINE) {
+    r->multi_words = WLN_RING_MULTI_INLINE; 
+    r->multi = r->multi_inline; 
+  }
+  else 
+    r->multi = (unsigned long long*)malloc(r->multi_words*sizeof(unsigned long long)); 
+  memset(r->multi, 0, r->multi_words*sizeof(unsigned long long)); 
   return r; 
 }
 
 
 static void wln_ring_free(struct wln_ring *r)
 {
+  if (r->sssr != r->sssr_inline)
+    free(r->sssr); 
+  if (r->multi != r->multi_inline)
+    free(r->multi); 
   free(r); 
 }
 
 
 static void wln_ring_add_subcycle(struct wln_ring *r, ring_t *ring)
 {
+  if (r->nsssr == r->sssr_alloc) {
+    r->sssr_alloc *= 2; 
+    if (r->sssr == r->sssr_inline) {
+      r->sssr = (ring_t**)malloc(r->sssr_alloc*sizeof(ring_t*)); 
+      memcpy(r->sssr, r->sssr_inline, r->nsssr*sizeof(ring_t*)); 
+    }
+    else 
+      r->sssr = (ring_t**)realloc(r->sssr, r->sssr_alloc*sizeof(ring_t*)); 
+  }
   r->sssr[r->nsssr++] = ring; 
 }
 
 
+#define wln_ring_set_multi(r, i)  (r)->multi[(i) >> 6] |= (1ULL << ((i) & 63))
+#define wln_ring_get_multi(r, i)  (((r)->multi[(i) >> 6] >> ((i) & 63)) & 1)
+
+
+static unsigned int wln_ring_count_multi(struct wln_ring *r)
+{
+  unsigned int count = 0; 
+  for (unsigned int w=0; w<r->multi_words; w++)
+    count += __builtin_popcountll(r->multi[w]); 
+  return count; 
+}
+
+
 static unsigned int symbol_ring_share_count(struct wln_ring *r, symbol_t *s) 
 {
   unsigned int memb = 0; 
@@ -462,10 +515,6 @@ static void wln_ring_fill_sssr(struct wln_ring *wln_ring,
 
   for (unsigned int i=0; i<size; i++)
     seen[symbol_get_id(wln_ring->locants[i])] = true; 
-
-#ifdef DEBUG
-  fprintf(stderr, "WLN cycle: %lu atoms, %lu SSSR\n", size, wln_ring->nsssr); 
-#endif
 }
 
 
@@ -554,10 +603,10 @@ static bool wln_ring_fill_locant_path(struct wln_ring *r,
   unsigned int *shares = (unsigned int*)malloc(sizeof(unsigned int)*size); 
   memset(shares, 0, sizeof(unsigned int)*size);  
   
-  const unsigned int natoms = graph_num_atoms(mol); 
+  const unsigned int nids = graph_id_bound(mol); 
 
-  bool *local_seen = (bool*)malloc(natoms); 
-  memset(local_seen, false, natoms); 
+  bool *local_seen = (bool*)malloc(nids); 
+  memset(local_seen, false, nids); 
 
   symbol_t **ordered_path = (symbol_t**)malloc(sizeof(symbol_t*)*size); 
   
@@ -578,14 +627,16 @@ static bool wln_ring_fill_locant_path(struct wln_ring *r,
                                      shares, 
                                      local_seen, 1)) 
   {
-    fprintf(stderr, "Error: no locant path possible for ring of size: %u\n", size); 
+    free(local_seen); 
+    free(ordered_path); 
+    free(shares); 
     return false; 
   }
   
   /* set up multi bit set */
   for (unsigned int i=0; i<size; i++) {
     if (symbol_ring_share_count(r, r->locants[i]) > 2) 
-      r->multi |= (1 << i); 
+      wln_ring_set_multi(r, i); 
   }
   
   free(local_seen); 
@@ -609,13 +660,27 @@ static int lowest_fusion_locant(struct wln_ring *r, ring_t *subcycle)
 static bool wln_write_cycle(struct wln_ring *r, 
                             graph_t *mol)
 {
+  /* the reader takes ring sizes as single digits, and the multi block as a 
+   * digit count followed by that many single letter locants */
+  const unsigned int sssr_size = r->nsssr; 
+  for (unsigned int i=0; i<sssr_size; i++) {
+    if (ring_get_size(r->sssr[i]) > 9) 
+      return false; 
+  }
+
+  const unsigned int nmulti = wln_ring_count_multi(r); 
+  if (nmulti > 9) 
+    return false; 
+  for (unsigned int pos=26; pos<r->size; pos++) {
+    if (wln_ring_get_multi(r, pos)) 
+      return false; 
+  }
+
   if (r->hetero) 
     wln_push('T');
   else 
     wln_push('L');
   
-  const unsigned int sssr_size = r->nsssr; 
-  
   int *atoms_seen = (int*)malloc(sizeof(int)*sssr_size);
   for (unsigned int i=0; i<sssr_size; i++) 
     atoms_seen[i] = ring_get_size(r->sssr[i]);  
@@ -629,7 +694,7 @@ static bool wln_write_cycle(struct wln_ring *r,
           int locant = lowest_fusion_locant(r, subcycle);
           if (locant != 0) {
             wln_push(' '); 
-            wln_push((locant + 'A')); 
+            wln_push_locant(locant); 
           }
           wln_push((ring_get_size(subcycle) + '0')); 
         }
@@ -638,20 +703,16 @@ static bool wln_write_cycle(struct wln_ring *r,
   }  
   
   /* write the multi block and size */
-  if (r->multi) {
+  if (nmulti) {
     wln_push(' ');
-    wln_push((__builtin_popcount(r->multi) + '0')); 
-
-    unsigned int pos = 0;
-    unsigned long long n = r->multi; 
-    while (n) {
-    if (n & 1)
-      wln_push((pos + 'A'));
-    n >>= 1; 
-    pos++; 
+    wln_push((nmulti + '0')); 
+
+    for (unsigned int pos=0; pos<r->size; pos++) {
+      if (wln_ring_get_multi(r, pos))
+        wln_push((pos + 'A'));
     }
     wln_push(' ');
-    wln_push((r->size-1 + 'A')); 
+    wln_push_locant(r->size-1); 
   }
 
   /* write any heteroatom assignments */ 
@@ -662,7 +723,7 @@ static bool wln_write_cycle(struct wln_ring *r,
       if (symbol_get_num(atom) != 6) {
         if (i != last_pos + 1) {
           wln_push(' ');
-          wln_push((i + 'A'));
+          wln_push_locant(i);
         }
         wln_write_element_symbol(atom); 
         last_pos = i; 
@@ -699,19 +760,26 @@ static int branch_recursive_write(graph_t *mol, symbol_t *atom)
 
         struct wln_ring *wln_ring = wln_ring_alloc(graph_num_atoms(mol));         
         wln_ring_fill_sssr(wln_ring, mol, nbor);  
-        if (!wln_ring_fill_locant_path(wln_ring, mol))
+        if (!wln_ring_fill_locant_path(wln_ring, mol)) {
+          wln_ring_free(wln_ring); 
           return WLN_ERROR; 
+        }
         
         for (unsigned l=0; l<wln_ring->size; l++) {
           if (wln_ring->locants[l] == nbor) {
-            wln_push((l + 'A')); 
+            wln_push_locant(l); 
             break; 
           }
         }
 
-        wln_write_cycle(wln_ring, mol); 
-        if (locant_recursive_write(wln_ring, mol) != WLN_OK)
+        if (!wln_write_cycle(wln_ring, mol)) {
+          wln_ring_free(wln_ring); 
           return WLN_ERROR; 
+        }
+        if (locant_recursive_write(wln_ring, mol) != WLN_OK) {
+          wln_ring_free(wln_ring); 
+          return WLN_ERROR; 
+        }
         wln_ring_free(wln_ring); 
         wln_push('&'); 
       }
@@ -749,7 +817,7 @@ static int locant_recursive_write(struct wln_ring *wln_ring,
       symbol_t *nbor = edge_get_nbor(edge, locant); 
       if (!symbol_is_cyclic(nbor) && !seen[symbol_get_id(nbor)]) {
         wln_push(' ');
-        wln_push((i + 'A'));
+        wln_push_locant(i);
 
         for (unsigned int o = 1; o < edge_get_order(edge); o++)
           wln_push('U'); 
@@ -763,56 +831,28 @@ static int locant_recursive_write(struct wln_ring *wln_ring,
 }
 
 
-/* all sequences of 1's can be folded into their singular numbers */
-static void fold_carbon_chains()
+static void seen_reserve(unsigned int nids)
 {
-  char aux[4096]; 
-  unsigned int naux = 0; 
-
-  int start = -1; 
-  unsigned int chain_len = 0;  
-  for (unsigned int i=0; i<wln_length(); i++) {
-    unsigned char ch = wln_at(i); 
-    if (ch == '1') {
-      if (start == -1) {
-        start = i; 
-        chain_len = 1; 
-      }
-      else 
-        chain_len++; 
-    }
-    else {
-      if (start != -1) {
-        while (chain_len > 0) {
-          unsigned char digit = (chain_len % 10) + '0';  // get rightmost digit
-          aux[naux++] = digit; 
-          chain_len = chain_len / 10;    // remove rightmost digit
-        }
-      }
-      aux[naux++] = ch;  
-      start = -1;
-    }
+  if (nids > seen_alloc) {
+    seen_alloc = nids; 
+    seen = (bool*)realloc(seen, seen_alloc); 
   }
+  memset(seen, 0, nids); 
+}
 
-  while (chain_len > 0) {
-    unsigned char digit = (chain_len % 10) + '0';  // get rightmost digit
-    aux[naux++] = digit; 
-    chain_len = chain_len / 10;    // remove rightmost digit
-  }
-  
-  memcpy(wln_out, aux, naux);
-  wln_length() = naux; 
-  wln_terminate(); 
+
+static void seen_release()
+{
+  free(seen); 
+  seen = (bool*)0; 
+  seen_alloc = 0; 
 }
 
 
-bool WriteWLN(char *buffer, unsigned int nbuffer, OBMol* mol)
+/* writes into the current target, see wln_target */
+static bool wln_write_molecule(graph_t *mol)
 {   
-  wln_out = buffer; 
-  wln_len = 0; 
-
-  seen = (bool*)malloc(graph_num_atoms(mol)); 
-  memset(seen, 0, graph_num_atoms(mol)); 
+  seen_reserve(graph_id_bound(mol)); 
 
   char new_mol = 0; 
   bool is_cyclic = graph_num_cycles(mol) > 0; 
@@ -856,11 +896,18 @@ bool WriteWLN(char *buffer, unsigned int nbuffer, OBMol* mol)
         seen[symbol_get_id(root)] = true; 
         struct wln_ring *wln_ring = wln_ring_alloc(graph_num_atoms(mol));         
         wln_ring_fill_sssr(wln_ring, mol, root);  
-        if (!wln_ring_fill_locant_path(wln_ring, mol))
+        if (!wln_ring_fill_locant_path(wln_ring, mol)) {
+          wln_ring_free(wln_ring); 
           return false; 
-        wln_write_cycle(wln_ring, mol);
-        if (locant_recursive_write(wln_ring, mol) != WLN_OK)
+        }
+        if (!wln_write_cycle(wln_ring, mol)) {
+          wln_ring_free(wln_ring); 
           return false; 
+        }
+        if (locant_recursive_write(wln_ring, mol) != WLN_OK) {
+          wln_ring_free(wln_ring); 
+          return false; 
+        }
         wln_ring_free(wln_ring); 
       }
     }
@@ -869,14 +916,155 @@ bool WriteWLN(char *buffer, unsigned int nbuffer, OBMol* mol)
   if (wln_length() == 0)
     return false; 
 
-  fold_carbon_chains(); 
   while (wln_back() == '&')
     wln_pop(); 
-  
-  fprintf(stderr, "%s\n", wln_out); 
+  wln_terminate(); 
+  return true; 
+}
 
-  free(seen); 
+
+bool WriteWLN(char *buffer, unsigned int nbuffer, OBMol* mol)
+{
+  wln_target(&wln_scratch, &wln_scratch_alloc, 0); 
+  if (!wln_write_molecule(mol))
+    return false; 
+
+  if (wln_len >= nbuffer)
+    return false; 
+  memcpy(buffer, wln_scratch, wln_len+1); 
   return true; 
 }
 
 
+long WriteWLNString(char **buffer, size_t *nbuffer, OBMol* mol)
+{
+  wln_target(buffer, nbuffer, 0); 
+  if (!wln_write_molecule(mol))
+    return -1; 
+  return wln_len; 
+}
+
+
+/*
+ * -- Batch Write WLN Notation --
+ *
+ * Each worker takes a contiguous run of molecules and emits straight into its 
+ * own arena, the runs are then joined in order into the callers arena. With a 
+ * single worker the callers arena is written directly.
+ */
+
+struct wlnwritejob {
+  OBMol **mols; 
+  unsigned int start; 
+  unsigned int end; 
+  char *arena; 
+  size_t narena;  /* allocated bytes */
+  size_t len;     /* used bytes */
+  size_t *offsets; 
+  unsigned int nwritten; 
+};
+
+
+static void* wln_batch_write_worker(void *arg)
+{
+  struct wlnwritejob *job = (struct wlnwritejob*)arg; 
+
+  for (unsigned int i=job->start; i<job->end; i++) {
+    job->offsets[i] = job->len; 
+    wln_target(&job->arena, &job->narena, job->len); 
+    if (!wln_write_molecule(job->mols[i]))
+      continue; 
+    job->len += wln_len; 
+    job->nwritten++; 
+  }
+  return NULL; 
+}
+
+
+/* spawned workers release their thread's workspace as they exit */
+static void* wln_batch_write_thread(void *arg)
+{
+  wln_batch_write_worker(arg); 
+  seen_release(); 
+  return NULL; 
+}
+
+
+unsigned int WriteWLNBatch(OBMol **mols, 
+                           unsigned int nmols, 
+                           char **arena, 
+                           size_t *narena, 
+                           size_t *offsets, 
+                           unsigned int nthreads)
+{
+  if (nthreads > nmols)
+    nthreads = nmols; 
+  if (!nthreads)
+    nthreads = 1; 
+
+  struct wlnwritejob *jobs = (struct wlnwritejob*)malloc(nthreads*sizeof(struct wlnwritejob)); 
+  const unsigned int per_job = (nmols + nthreads - 1) / nthreads; 
+  for (unsigned int t=0; t<nthreads; t++) {
+    struct wlnwritejob *job = &jobs[t]; 
+    job->mols     = mols; 
+    job->start    = t * per_job; 
+    job->end      = job->start + per_job < nmols ? job->start + per_job : nmols; 
+    job->arena    = NULL; 
+    job->narena   = 0; 
+    job->len      = 0; 
+    job->offsets  = offsets; 
+    job->nwritten = 0; 
+  }
+
+  /* the first job always runs on the calling thread into the callers arena */
+  jobs[0].arena  = *arena; 
+  jobs[0].narena = *narena; 
+
+  pthread_t *workers = (pthread_t*)malloc(nthreads*sizeof(pthread_t)); 
+  bool *spawned = (bool*)malloc(nthreads); 
+  for (unsigned int t=1; t<nthreads; t++) 
+    spawned[t] = pthread_create(&workers[t], NULL, wln_batch_write_thread, &jobs[t]) == 0; 
+
+  wln_batch_write_worker(&jobs[0]); 
+  for (unsigned int t=1; t<nthreads; t++) {
+    if (spawned[t])
+      pthread_join(workers[t], NULL); 
+    else 
+      wln_batch_write_worker(&jobs[t]); 
+  }
+
+  size_t total = 0; 
+  for (unsigned int t=0; t<nthreads; t++) 
+    total += jobs[t].len; 
+
+  char *out = jobs[0].arena; 
+  size_t nout = jobs[0].narena; 
+  if (total > nout) {
+    nout = total; 
+    out = (char*)realloc(out, nout); 
+  }
+
+  unsigned int nwritten = jobs[0].nwritten; 
+  size_t base = jobs[0].len; 
+  for (unsigned int t=1; t<nthreads; t++) {
+    struct wlnwritejob *job = &jobs[t]; 
+    if (job->len)
+      memcpy(out + base, job->arena, job->len); 
+    for (unsigned int i=job->start; i<job->end; i++)
+      offsets[i] += base; 
+    base += job->len; 
+    nwritten += job->nwritten; 
+    free(job->arena); 
+  }
+  offsets[nmols] = total; 
+
+  *arena  = out; 
+  *narena = nout; 
+
+  free(spawned); 
+  free(workers); 
+  free(jobs); 
+  return nwritten; 
+}
+
+
@@ -1,6 +1,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
 
 #ifdef USING_OPENBABEL
 #include <openbabel/mol.h>
@@ -16,9 +18,13 @@
 #endif
 
 #include "wlnparser.h"
+#include "wlnoutput.h"
 
 FILE *fp; 
 const char *format; 
+bool opt_line_flush; 
+
+struct wln_output out; 
 
 
 static unsigned char 
@@ -81,9 +87,9 @@ process_file(FILE *fp)
   while (readline(fp, buffer, 4096, 0)) {
     conv.ReadString(&mol, buffer); 
     if (WriteWLN(wlnout, 1024, &mol))
-      fprintf(stdout, "%s\n", wlnout); 
+      wln_output_line(&out, wlnout); 
     else 
-      fprintf(stdout, "NULL\n"); 
+      wln_output_line(&out, "NULL"); 
     mol.Clear(); 
   }
 }
@@ -95,6 +101,7 @@ display_usage()
   fprintf(stderr, "writewln <options> -i<format> <input>\n");
   fprintf(stderr, "<options>\n");
   fprintf(stderr, "  -i                    choose input format (-ismi, -iinchi, -ican, -imol)\n");
+  fprintf(stderr, "  -l                    flush output after every line, default when writing to a terminal\n");
   exit(1);
 }
 
@@ -108,11 +115,13 @@ process_cml(int argc, char *argv[])
   
   fp = NULL; 
   format = (const char *)0;
+  opt_line_flush = isatty(STDOUT_FILENO); 
 
   for (i = 1; i < argc; i++) {
     ptr = argv[i];
     if (ptr[0] == '-' && ptr[1]) switch (ptr[1]) {
       case 'i': format = &ptr[2]; break; 
+      case 'l': opt_line_flush = true; break; 
       default:
         fprintf(stderr, "Error: unrecognised input %s\n", ptr);
         display_usage();
@@ -147,7 +156,9 @@ int
 main(int argc, char *argv[])
 {
   process_cml(argc, argv);
+  wln_output_init(&out, STDOUT_FILENO, opt_line_flush); 
   process_file(fp);  
+  wln_output_free(&out); 
   if (fp != stdin) fclose(fp); 
   return 0;
 }